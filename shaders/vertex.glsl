@@ -1,15 +1,26 @@
 #version 330 core
 
-layout (location = 0) in vec3 aPos;
-layout (location = 1) in vec3 aColor;
+// x (5 bits), y (9 bits), z (5 bits), face (3 bits) | block id
+layout (location = 0) in uvec2 aVertex;
+// Per draw, from an instanced buffer or set between draws
+layout (location = 1) in vec3 aChunkOffset;
 
 out vec3 vertexColor;
 
 uniform mat4 projection;
 uniform mat4 view;
 uniform mat4 model;
+uniform vec3 blockColors[32];
+
+// Top, bottom, east, west, south, north
+const float faceBrightness[6] = float[6](1.0, 0.5, 0.8, 0.8, 0.7, 0.7);
 
 void main() {
-    gl_Position = projection * view * model * vec4(aPos, 1.0);
-    vertexColor = aColor;
+    vec3 local = vec3(float(aVertex.x & 31u),
+                      float((aVertex.x >> 5) & 511u),
+                      float((aVertex.x >> 14) & 31u));
+    uint face = (aVertex.x >> 19) & 7u;
+    
+    gl_Position = projection * view * model * vec4(aChunkOffset + local, 1.0);
+    vertexColor = blockColors[aVertex.y & 31u] * faceBrightness[face];
 }
\ No newline at end of file
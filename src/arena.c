@@ -0,0 +1,163 @@
+#include "arena.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define ARENA_FREE_INITIAL 64
+
+static bool reserve_free(Arena* arena, int count) {
+    if (count <= arena->free_capacity) return true;
+    
+    int capacity = arena->free_capacity > 0 ? arena->free_capacity : ARENA_FREE_INITIAL;
+    while (capacity < count) capacity *= 2;
+    
+    ArenaRange* ranges = (ArenaRange*)realloc(arena->free, capacity * sizeof(ArenaRange));
+    if (!ranges) return false;
+    
+    arena->free = ranges;
+    arena->free_capacity = capacity;
+    return true;
+}
+
+// Starts out as one free range covering everything
+bool arena_init(Arena* arena, uint32_t capacity) {
+    arena->free = NULL;
+    arena->free_count = 0;
+    arena->free_capacity = 0;
+    arena->capacity = capacity;
+    arena->used = 0;
+    arena->allocations = 0;
+    
+    if (!reserve_free(arena, ARENA_FREE_INITIAL)) return false;
+    
+    if (capacity > 0) {
+        arena->free[0].offset = 0;
+        arena->free[0].size = capacity;
+        arena->free_count = 1;
+    }
+    return true;
+}
+
+void arena_destroy(Arena* arena) {
+    free(arena->free);
+    arena->free = NULL;
+    arena->free_count = 0;
+    arena->free_capacity = 0;
+}
+
+// Best fit, so big ranges stay whole for big meshes. False if no free
+// range is large enough, or if the free list can't grow.
+bool arena_alloc(Arena* arena, uint32_t size, uint32_t* offset) {
+    if (size == 0) return false;
+    
+    // Free ranges are separated by allocations, so there are at most one
+    // more than allocations. Making room here means arena_free never has
+    // to grow the list, and can't fail.
+    if (!reserve_free(arena, arena->allocations + 2)) return false;
+    
+    int best = -1;
+    for (int i = 0; i < arena->free_count; i++) {
+        uint32_t range_size = arena->free[i].size;
+        if (range_size < size) continue;
+        if (best < 0 || range_size < arena->free[best].size) {
+            best = i;
+            if (range_size == size) break;
+        }
+    }
+    if (best < 0) return false;
+    
+    ArenaRange* range = &arena->free[best];
+    *offset = range->offset;
+    range->offset += size;
+    range->size -= size;
+    
+    if (range->size == 0) {
+        memmove(range, range + 1, (arena->free_count - best - 1) * sizeof(ArenaRange));
+        arena->free_count--;
+    }
+    
+    arena->used += size;
+    arena->allocations++;
+    return true;
+}
+
+// Give back a range from arena_alloc, merging it with free neighbors
+void arena_free(Arena* arena, uint32_t offset, uint32_t size) {
+    if (size == 0) return;
+    
+    // First free range after this one
+    int low = 0;
+    int high = arena->free_count;
+    while (low < high) {
+        int mid = (low + high) / 2;
+        if (arena->free[mid].offset < offset) low = mid + 1;
+        else high = mid;
+    }
+    
+    bool joins_prev = low > 0 &&
+                      arena->free[low - 1].offset + arena->free[low - 1].size == offset;
+    bool joins_next = low < arena->free_count &&
+                      offset + size == arena->free[low].offset;
+    
+    if (joins_prev && joins_next) {
+        arena->free[low - 1].size += size + arena->free[low].size;
+        memmove(&arena->free[low], &arena->free[low + 1],
+                (arena->free_count - low - 1) * sizeof(ArenaRange));
+        arena->free_count--;
+    } else if (joins_prev) {
+        arena->free[low - 1].size += size;
+    } else if (joins_next) {
+        arena->free[low].offset = offset;
+        arena->free[low].size += size;
+    } else {
+        // Room was made by arena_alloc; without it the range would be lost,
+        // so it stays counted as used
+        if (!reserve_free(arena, arena->free_count + 1)) return;
+        
+        memmove(&arena->free[low + 1], &arena->free[low],
+                (arena->free_count - low) * sizeof(ArenaRange));
+        arena->free[low].offset = offset;
+        arena->free[low].size = size;
+        arena->free_count++;
+    }
+    
+    arena->used -= size;
+    arena->allocations--;
+}
+
+// Extend the end of the arena, existing allocations stay where they are
+bool arena_grow(Arena* arena, uint32_t capacity) {
+    if (capacity <= arena->capacity) return true;
+    
+    uint32_t added = capacity - arena->capacity;
+    ArenaRange* last = arena->free_count > 0 ? &arena->free[arena->free_count - 1] : NULL;
+    
+    if (last && last->offset + last->size == arena->capacity) {
+        last->size += added;
+    } else {
+        if (!reserve_free(arena, arena->free_count + 1)) return false;
+        arena->free[arena->free_count].offset = arena->capacity;
+        arena->free[arena->free_count].size = added;
+        arena->free_count++;
+    }
+    
+    arena->capacity = capacity;
+    return true;
+}
+
+void arena_get_stats(const Arena* arena, ArenaStats* stats) {
+    stats->capacity = arena->capacity;
+    stats->used = arena->used;
+    stats->allocations = arena->allocations;
+    stats->free_ranges = arena->free_count;
+    stats->largest_free = 0;
+    
+    for (int i = 0; i < arena->free_count; i++) {
+        if (arena->free[i].size > stats->largest_free) {
+            stats->largest_free = arena->free[i].size;
+        }
+    }
+    
+    uint32_t free_total = arena->capacity - arena->used;
+    stats->fragmentation = free_total > 0 ?
+        1.0f - (float)stats->largest_free / (float)free_total : 0.0f;
+}
\ No newline at end of file
@@ -0,0 +1,39 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Suballocator for one large buffer, in caller-defined units. Only does
+// the bookkeeping, so it knows nothing about GL.
+typedef struct {
+    uint32_t offset;
+    uint32_t size;
+} ArenaRange;
+
+typedef struct {
+    ArenaRange* free;       // Sorted by offset, never touching each other
+    int free_count;
+    int free_capacity;
+    uint32_t capacity;
+    uint32_t used;
+    int allocations;
+} Arena;
+
+typedef struct {
+    uint32_t capacity;
+    uint32_t used;
+    int allocations;
+    int free_ranges;
+    uint32_t largest_free;
+    float fragmentation;    // Share of free space outside the largest range
+} ArenaStats;
+
+bool arena_init(Arena* arena, uint32_t capacity);
+void arena_destroy(Arena* arena);
+bool arena_alloc(Arena* arena, uint32_t size, uint32_t* offset);
+void arena_free(Arena* arena, uint32_t offset, uint32_t size);
+bool arena_grow(Arena* arena, uint32_t capacity);
+void arena_get_stats(const Arena* arena, ArenaStats* stats);
+
+#endif
\ No newline at end of file
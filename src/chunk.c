@@ -1,16 +1,369 @@
 #include "chunk.h"
+#include "visibility.h"
 #include <stdlib.h>
 #include <string.h>
+#include <pthread.h>
+
+// Recycled sections, shared by all chunks. Worker threads generate and
+// snapshot chunks too, so the free lists are guarded by pool_lock.
+static ChunkSection* free_sections = NULL;
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static ChunkSection* section_take(void) {
+    pthread_mutex_lock(&pool_lock);
+    ChunkSection* section = free_sections;
+    if (section) free_sections = section->next_free;
+    pthread_mutex_unlock(&pool_lock);
+    
+    if (section) {
+        section->next_free = NULL;
+        return section;
+    }
+    
+    section = (ChunkSection*)malloc(sizeof(ChunkSection));
+    if (section) section->next_free = NULL;
+    return section;
+}
+
+#if CHUNK_PALETTE_STORAGE
+
+#define SECTION_WORDS(bits) (CHUNK_SECTION_VOLUME * (bits) / 64)
+
+// Packed index buffers recycled per width, linked through their first word
+static uint64_t* free_data[4] = {NULL, NULL, NULL, NULL};
+
+static int bits_class(int bits) {
+    return bits == 1 ? 0 : bits == 2 ? 1 : bits == 4 ? 2 : 3;
+}
+
+static int bits_for_palette(int palette_size) {
+    if (palette_size <= 2) return 1;
+    if (palette_size <= 4) return 2;
+    if (palette_size <= 16) return 4;
+    return 8;
+}
+
+static uint64_t* data_alloc(int bits) {
+    size_t size = SECTION_WORDS(bits) * sizeof(uint64_t);
+    int c = bits_class(bits);
+    
+    pthread_mutex_lock(&pool_lock);
+    uint64_t* data = free_data[c];
+    if (data) free_data[c] = *(uint64_t**)data;
+    pthread_mutex_unlock(&pool_lock);
+    
+    if (!data) {
+        data = (uint64_t*)malloc(size);
+        if (!data) return NULL;
+    }
+    
+    memset(data, 0, size);
+    return data;
+}
+
+static void data_free(uint64_t* data, int bits) {
+    int c = bits_class(bits);
+    pthread_mutex_lock(&pool_lock);
+    *(uint64_t**)data = free_data[c];
+    free_data[c] = data;
+    pthread_mutex_unlock(&pool_lock);
+}
+
+static inline int index_load(const uint64_t* data, int bits, int i) {
+    int bit = i * bits;
+    return (int)((data[bit >> 6] >> (bit & 63)) & ((1ULL << bits) - 1));
+}
+
+static inline void index_store(uint64_t* data, int bits, int i, int value) {
+    int bit = i * bits;
+    uint64_t mask = ((1ULL << bits) - 1) << (bit & 63);
+    data[bit >> 6] = (data[bit >> 6] & ~mask) | ((uint64_t)value << (bit & 63));
+}
+
+static void section_free(ChunkSection* section) {
+    if (section->data) {
+        data_free(section->data, section->bits);
+        section->data = NULL;
+    }
+    pthread_mutex_lock(&pool_lock);
+    section->next_free = free_sections;
+    free_sections = section;
+    pthread_mutex_unlock(&pool_lock);
+}
+
+static ChunkSection* section_alloc(uint8_t fill) {
+    ChunkSection* section = section_take();
+    if (!section) return NULL;
+    
+    section->data = data_alloc(1);
+    if (!section->data) {
+        section_free(section);
+        return NULL;
+    }
+    
+    // All-zero indices map every block to the fill entry
+    section->bits = 1;
+    section->palette_size = 1;
+    section->palette[0] = fill;
+    section->block_count = (fill == BLOCK_AIR) ? 0 : CHUNK_SECTION_VOLUME;
+    return section;
+}
+
+// Repack the indices at a wider bit width
+static bool section_grow(ChunkSection* section, int bits) {
+    uint64_t* data = data_alloc(bits);
+    if (!data) return false;
+    
+    for (int i = 0; i < CHUNK_SECTION_VOLUME; i++) {
+        index_store(data, bits, i, index_load(section->data, section->bits, i));
+    }
+    
+    data_free(section->data, section->bits);
+    section->data = data;
+    section->bits = bits;
+    return true;
+}
+
+static int palette_lookup(ChunkSection* section, uint8_t type) {
+    for (int i = 0; i < section->palette_size; i++) {
+        if (section->palette[i] == type) return i;
+    }
+    
+    if (section->palette_size >= BLOCK_COUNT) return -1;
+    
+    if (section->palette_size == (1 << section->bits) &&
+        !section_grow(section, section->bits * 2)) {
+        return -1;
+    }
+    
+    section->palette[section->palette_size] = type;
+    return section->palette_size++;
+}
+
+static inline BlockType section_get(const ChunkSection* section, int index) {
+    return (BlockType)section->palette[index_load(section->data, section->bits, index)];
+}
+
+static bool section_set(ChunkSection* section, int index, BlockType type) {
+    int palette_index = palette_lookup(section, (uint8_t)type);
+    if (palette_index < 0) return false;
+    
+    index_store(section->data, section->bits, index, palette_index);
+    return true;
+}
+
+// Word-at-a-time decode, specialized per width by the switch below
+static inline void unpack_indices(const ChunkSection* section, uint8_t* out, const int bits) {
+    const uint64_t mask = (1ULL << bits) - 1;
+    
+    for (int w = 0; w < SECTION_WORDS(bits); w++) {
+        uint64_t word = section->data[w];
+        for (int k = 0; k < 64 / bits; k++) {
+            *out++ = section->palette[word & mask];
+            word >>= bits;
+        }
+    }
+}
+
+static void section_decode(const ChunkSection* section, uint8_t* out) {
+    switch (section->bits) {
+        case 1: unpack_indices(section, out, 1); break;
+        case 2: unpack_indices(section, out, 2); break;
+        case 4: unpack_indices(section, out, 4); break;
+        default: unpack_indices(section, out, 8); break;
+    }
+}
+
+// One column of the section, bottom to top, at a constant width
+static inline void unpack_column(const ChunkSection* section, int x, int z, uint8_t* out,
+                                 const int bits) {
+    for (int y = 0; y < CHUNK_SECTION_HEIGHT; y++) {
+        out[y] = section->palette[index_load(section->data, bits, SECTION_INDEX(x, y, z))];
+    }
+}
+
+static void section_decode_column(const ChunkSection* section, int x, int z, uint8_t* out) {
+    switch (section->bits) {
+        case 1: unpack_column(section, x, z, out, 1); break;
+        case 2: unpack_column(section, x, z, out, 2); break;
+        case 4: unpack_column(section, x, z, out, 4); break;
+        default: unpack_column(section, x, z, out, 8); break;
+    }
+}
+
+// Inverse of unpack_indices, packs a whole word per iteration
+static inline void pack_indices(uint64_t* data, const uint8_t* blocks,
+                                const int16_t* lookup, const int bits) {
+    for (int w = 0; w < SECTION_WORDS(bits); w++) {
+        uint64_t word = 0;
+        for (int k = 0; k < 64 / bits; k++) {
+            word |= (uint64_t)lookup[*blocks++] << (k * bits);
+        }
+        data[w] = word;
+    }
+}
+
+static ChunkSection* section_from_blocks(const uint8_t* blocks, int block_count) {
+    ChunkSection* section = section_take();
+    if (!section) return NULL;
+    
+    // Build the palette in order of first appearance
+    int16_t lookup[256];
+    memset(lookup, -1, sizeof(lookup));
+    section->palette_size = 0;
+    
+    for (int i = 0; i < CHUNK_SECTION_VOLUME; i++) {
+        if (lookup[blocks[i]] < 0) {
+            if (section->palette_size >= BLOCK_COUNT) {
+                section->data = NULL;
+                section_free(section);
+                return NULL;
+            }
+            lookup[blocks[i]] = (int16_t)section->palette_size;
+            section->palette[section->palette_size++] = blocks[i];
+        }
+    }
+    
+    section->bits = bits_for_palette(section->palette_size);
+    section->data = data_alloc(section->bits);
+    if (!section->data) {
+        section_free(section);
+        return NULL;
+    }
+    
+    switch (section->bits) {
+        case 1: pack_indices(section->data, blocks, lookup, 1); break;
+        case 2: pack_indices(section->data, blocks, lookup, 2); break;
+        case 4: pack_indices(section->data, blocks, lookup, 4); break;
+        default: pack_indices(section->data, blocks, lookup, 8); break;
+    }
+    
+    section->block_count = block_count;
+    return section;
+}
+
+static ChunkSection* section_clone(const ChunkSection* source) {
+    ChunkSection* section = section_take();
+    if (!section) return NULL;
+    
+    section->data = data_alloc(source->bits);
+    if (!section->data) {
+        section_free(section);
+        return NULL;
+    }
+    
+    section->block_count = source->block_count;
+    section->bits = source->bits;
+    section->palette_size = source->palette_size;
+    memcpy(section->palette, source->palette, sizeof(section->palette));
+    memcpy(section->data, source->data, SECTION_WORDS(source->bits) * sizeof(uint64_t));
+    return section;
+}
+
+static size_t section_memory_usage(const ChunkSection* section) {
+    return sizeof(ChunkSection) + SECTION_WORDS(section->bits) * sizeof(uint64_t);
+}
+
+#else
+
+static void section_free(ChunkSection* section) {
+    pthread_mutex_lock(&pool_lock);
+    section->next_free = free_sections;
+    free_sections = section;
+    pthread_mutex_unlock(&pool_lock);
+}
+
+static ChunkSection* section_alloc(uint8_t fill) {
+    ChunkSection* section = section_take();
+    if (!section) return NULL;
+    
+    memset(section->blocks, fill, sizeof(section->blocks));
+    section->block_count = (fill == BLOCK_AIR) ? 0 : CHUNK_SECTION_VOLUME;
+    return section;
+}
+
+static inline BlockType section_get(const ChunkSection* section, int index) {
+    return (BlockType)section->blocks[index];
+}
+
+static bool section_set(ChunkSection* section, int index, BlockType type) {
+    section->blocks[index] = (uint8_t)type;
+    return true;
+}
+
+static void section_decode(const ChunkSection* section, uint8_t* out) {
+    memcpy(out, section->blocks, CHUNK_SECTION_VOLUME);
+}
+
+static void section_decode_column(const ChunkSection* section, int x, int z, uint8_t* out) {
+    for (int y = 0; y < CHUNK_SECTION_HEIGHT; y++) {
+        out[y] = section->blocks[SECTION_INDEX(x, y, z)];
+    }
+}
+
+static ChunkSection* section_from_blocks(const uint8_t* blocks, int block_count) {
+    ChunkSection* section = section_take();
+    if (!section) return NULL;
+    
+    memcpy(section->blocks, blocks, CHUNK_SECTION_VOLUME);
+    section->block_count = block_count;
+    return section;
+}
+
+static ChunkSection* section_clone(const ChunkSection* source) {
+    ChunkSection* section = section_take();
+    if (!section) return NULL;
+    
+    memcpy(section->blocks, source->blocks, sizeof(section->blocks));
+    section->block_count = source->block_count;
+    return section;
+}
+
+static size_t section_memory_usage(const ChunkSection* section) {
+    return sizeof(ChunkSection);
+}
+
+#endif
+
+static void release_sections(Chunk* chunk) {
+    for (int i = 0; i < CHUNK_SECTION_COUNT; i++) {
+        if (chunk->sections[i]) {
+            section_free(chunk->sections[i]);
+            chunk->sections[i] = NULL;
+        }
+        chunk->section_fill[i] = BLOCK_AIR;
+        chunk->section_graph[i] = VISIBILITY_ALL;
+    }
+    chunk->graph_stale = 0;
+}
 
 Chunk* chunk_create(int x, int z) {
     Chunk* chunk = (Chunk*)malloc(sizeof(Chunk));
     if (!chunk) return NULL;
     
+    for (int i = 0; i < CHUNK_SECTION_COUNT; i++) {
+        chunk->sections[i] = NULL;
+    }
+    chunk_reset(chunk, x, z);
+    
+    return chunk;
+}
+
+// Reinitialize a chunk for new coordinates, used when recycling from the pool
+void chunk_reset(Chunk* chunk, int x, int z) {
+    if (!chunk) return;
+    
     chunk->x = x;
     chunk->z = z;
+    chunk->state = CHUNK_STATE_QUEUED;
     chunk->is_generated = false;
     chunk->is_dirty = true;
+    chunk->is_modified = false;
+    chunk->save_failed = false;
+    chunk->is_saving = false;
     chunk->mesh = NULL;
+    chunk->visibility_frame = 0;
+    chunk->visible_sections = 0;
     
     // Initialize neighbors to NULL
     chunk->north = NULL;
@@ -18,15 +371,14 @@ Chunk* chunk_create(int x, int z) {
     chunk->east = NULL;
     chunk->west = NULL;
     
-    // Clear blocks
-    memset(chunk->blocks, 0, sizeof(chunk->blocks));
-    
-    return chunk;
+    // Clear blocks, an empty chunk has no sections at all
+    release_sections(chunk);
 }
 
 void chunk_destroy(Chunk* chunk) {
     if (chunk) {
         // Mesh is freed by renderer
+        release_sections(chunk);
         free(chunk);
     }
 }
@@ -37,7 +389,10 @@ BlockType chunk_get_block(Chunk* chunk, int x, int y, int z) {
     if (x >= 0 && x < CHUNK_SIZE && 
         y >= 0 && y < CHUNK_HEIGHT && 
         z >= 0 && z < CHUNK_SIZE) {
-        return chunk->blocks[x][y][z];
+        int sy = y / CHUNK_SECTION_HEIGHT;
+        ChunkSection* section = chunk->sections[sy];
+        if (!section) return (BlockType)chunk->section_fill[sy];
+        return section_get(section, SECTION_INDEX(x, y % CHUNK_SECTION_HEIGHT, z));
     }
     
     return BLOCK_AIR;
@@ -50,9 +405,53 @@ void chunk_set_block(Chunk* chunk, int x, int y, int z, BlockType type) {
         y >= 0 && y < CHUNK_HEIGHT && 
         z >= 0 && z < CHUNK_SIZE) {
         
-        if (chunk->blocks[x][y][z] != type) {
-            chunk->blocks[x][y][z] = type;
+        int sy = y / CHUNK_SECTION_HEIGHT;
+        ChunkSection* section = chunk->sections[sy];
+        
+        if (!section) {
+            if (chunk->section_fill[sy] == type) return;
+            
+            // First differing block, expand the uniform section
+            section = section_alloc(chunk->section_fill[sy]);
+            if (!section) return;
+            chunk->sections[sy] = section;
+        }
+        
+        int index = SECTION_INDEX(x, y % CHUNK_SECTION_HEIGHT, z);
+        BlockType old = section_get(section, index);
+        
+        if (old != type) {
+            if (!section_set(section, index, type)) return;
+            if (old == BLOCK_AIR) section->block_count++;
+            if (type == BLOCK_AIR) section->block_count--;
+            
+            // Drop sections that became all air
+            if (section->block_count == 0) {
+                section_free(section);
+                chunk->sections[sy] = NULL;
+                chunk->section_fill[sy] = BLOCK_AIR;
+            }
+            
+            // Swapping a block for one just as see-through keeps the graph
+            bool reconnects = block_is_transparent(old) != block_is_transparent(type);
+            
+            // Until the chunk is published only its generator touches it,
+            // possibly on a worker thread, so leave the shared flags alone
+            if (!chunk->is_generated) {
+                if (reconnects) chunk->graph_stale |= (uint16_t)(1 << sy);
+                return;
+            }
+            
+            // Edits are rare, redo the edited section's graph right away so
+            // the renderer never sees through a freshly placed wall late
+            if (reconnects) {
+                uint8_t blocks[CHUNK_SECTION_VOLUME];
+                chunk_read_section(chunk, sy, blocks);
+                chunk_update_graph(chunk, sy, blocks);
+            }
+            
             chunk->is_dirty = true;
+            chunk->is_modified = true;
             
             // Mark neighboring chunks dirty if on edge
             if (x == 0 && chunk->west) {
@@ -80,7 +479,7 @@ BlockType chunk_get_neighbor_block(Chunk* chunk, int x, int y, int z) {
     
     // If within this chunk, return directly
     if (x >= 0 && x < CHUNK_SIZE && z >= 0 && z < CHUNK_SIZE) {
-        return chunk->blocks[x][y][z];
+        return chunk_get_block(chunk, x, y, z);
     }
     
     // Check neighboring chunks
@@ -137,4 +536,124 @@ bool chunk_is_block_visible(Chunk* chunk, int x, int y, int z) {
     }
     
     return false;
+}
+
+bool chunk_section_is_empty(Chunk* chunk, int section_y) {
+    if (!chunk || section_y < 0 || section_y >= CHUNK_SECTION_COUNT) return true;
+    
+    return !chunk->sections[section_y] && chunk->section_fill[section_y] == BLOCK_AIR;
+}
+
+// Copy a section out as a dense SECTION_INDEX-ordered array
+void chunk_read_section(Chunk* chunk, int section_y, uint8_t* out_blocks) {
+    ChunkSection* section = chunk->sections[section_y];
+    if (section) {
+        section_decode(section, out_blocks);
+    } else {
+        memset(out_blocks, chunk->section_fill[section_y], CHUNK_SECTION_VOLUME);
+    }
+}
+
+// Copy the section's column at local (x, z) out bottom to top,
+// CHUNK_SECTION_HEIGHT blocks
+void chunk_read_column(Chunk* chunk, int section_y, int x, int z, uint8_t* out_blocks) {
+    ChunkSection* section = chunk->sections[section_y];
+    if (section) {
+        section_decode_column(section, x, z, out_blocks);
+    } else {
+        memset(out_blocks, chunk->section_fill[section_y], CHUNK_SECTION_HEIGHT);
+    }
+}
+
+// Replace a whole section, collapsing it to a uniform fill when possible
+void chunk_write_section(Chunk* chunk, int section_y, const uint8_t* blocks) {
+    if (chunk->sections[section_y]) {
+        section_free(chunk->sections[section_y]);
+        chunk->sections[section_y] = NULL;
+    }
+    
+    // Eight blocks per step: count non-air (zero) bytes and compare
+    // against the first block repeated
+    const uint64_t low7 = 0x7F7F7F7F7F7F7F7FULL;
+    uint64_t first = blocks[0] * 0x0101010101010101ULL;
+    uint64_t differs = 0;
+    int block_count = 0;
+    
+    for (int i = 0; i < CHUNK_SECTION_VOLUME; i += 8) {
+        uint64_t word;
+        memcpy(&word, blocks + i, sizeof(word));
+        block_count += __builtin_popcountll((((word & low7) + low7) | word) & ~low7);
+        differs |= word ^ first;
+    }
+    bool uniform = (differs == 0);
+    
+    chunk->section_fill[section_y] = uniform ? blocks[0] : BLOCK_AIR;
+    if (uniform) {
+        chunk->section_graph[section_y] = visibility_uniform_graph((BlockType)blocks[0]);
+        chunk->graph_stale &= (uint16_t)~(1 << section_y);
+        return;
+    }
+    
+    chunk->sections[section_y] = section_from_blocks(blocks, block_count);
+    chunk->graph_stale |= (uint16_t)(1 << section_y);
+}
+
+// Replace dst's blocks with a private copy of src's, so the copy can be
+// read on another thread while src keeps changing
+bool chunk_copy_blocks(Chunk* dst, const Chunk* src) {
+    release_sections(dst);
+    dst->x = src->x;
+    dst->z = src->z;
+    dst->is_generated = src->is_generated;
+    
+    memcpy(dst->section_graph, src->section_graph, sizeof(dst->section_graph));
+    dst->graph_stale = src->graph_stale;
+    
+    for (int i = 0; i < CHUNK_SECTION_COUNT; i++) {
+        dst->section_fill[i] = src->section_fill[i];
+        if (src->sections[i]) {
+            dst->sections[i] = section_clone(src->sections[i]);
+            if (!dst->sections[i]) return false;
+        }
+    }
+    
+    return true;
+}
+
+// Connectivity of a section's faces, all connected until it's known
+uint16_t chunk_section_graph(const Chunk* chunk, int section_y) {
+    if ((chunk->graph_stale >> section_y) & 1) return VISIBILITY_ALL;
+    return chunk->section_graph[section_y];
+}
+
+// Recompute a section's graph from its blocks as read by chunk_read_section
+void chunk_update_graph(Chunk* chunk, int section_y, const uint8_t* blocks) {
+    chunk->section_graph[section_y] = visibility_section_graph(blocks);
+    chunk->graph_stale &= (uint16_t)~(1 << section_y);
+}
+
+// Keep the graphs a mesh job worked out on a snapshot of the chunk.
+// Sections no longer stale were edited since, which updated them already.
+void chunk_take_graphs(Chunk* chunk, const Chunk* snapshot) {
+    for (int sy = 0; sy < CHUNK_SECTION_COUNT; sy++) {
+        uint16_t bit = (uint16_t)(1 << sy);
+        if ((chunk->graph_stale & bit) && !(snapshot->graph_stale & bit)) {
+            chunk->section_graph[sy] = snapshot->section_graph[sy];
+            chunk->graph_stale &= (uint16_t)~bit;
+        }
+    }
+}
+
+// Bytes held by the chunk and its sections
+size_t chunk_memory_usage(Chunk* chunk) {
+    if (!chunk) return 0;
+    
+    size_t total = sizeof(Chunk);
+    for (int i = 0; i < CHUNK_SECTION_COUNT; i++) {
+        if (chunk->sections[i]) {
+            total += section_memory_usage(chunk->sections[i]);
+        }
+    }
+    
+    return total;
 }
\ No newline at end of file
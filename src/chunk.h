@@ -1,18 +1,99 @@
 #ifndef CHUNK_H
 #define CHUNK_H
 
+#include <stddef.h>
 #include <stdint.h>
 #include <stdbool.h>
 #include "blocks.h"
 #include "config.h"
 
+#define CHUNK_SECTION_HEIGHT 16
+#define CHUNK_SECTION_COUNT (CHUNK_HEIGHT / CHUNK_SECTION_HEIGHT)
+#define CHUNK_SECTION_VOLUME (CHUNK_SIZE * CHUNK_SECTION_HEIGHT * CHUNK_SIZE)
+
+// Index of a block inside a section (y is section-local), its inverse,
+// and the index distance between neighbors along each axis
+#if CHUNK_LAYOUT == CHUNK_LAYOUT_XZY
+#define SECTION_INDEX(x, y, z) \
+    (((x) * CHUNK_SIZE + (z)) * CHUNK_SECTION_HEIGHT + (y))
+#define SECTION_X(i) ((i) / (CHUNK_SIZE * CHUNK_SECTION_HEIGHT))
+#define SECTION_Y(i) ((i) % CHUNK_SECTION_HEIGHT)
+#define SECTION_Z(i) (((i) / CHUNK_SECTION_HEIGHT) % CHUNK_SIZE)
+#define SECTION_STRIDE_X (CHUNK_SIZE * CHUNK_SECTION_HEIGHT)
+#define SECTION_STRIDE_Y 1
+#define SECTION_STRIDE_Z CHUNK_SECTION_HEIGHT
+#elif CHUNK_LAYOUT == CHUNK_LAYOUT_YZX
+#define SECTION_INDEX(x, y, z) \
+    (((y) * CHUNK_SIZE + (z)) * CHUNK_SIZE + (x))
+#define SECTION_X(i) ((i) % CHUNK_SIZE)
+#define SECTION_Y(i) ((i) / (CHUNK_SIZE * CHUNK_SIZE))
+#define SECTION_Z(i) (((i) / CHUNK_SIZE) % CHUNK_SIZE)
+#define SECTION_STRIDE_X 1
+#define SECTION_STRIDE_Y (CHUNK_SIZE * CHUNK_SIZE)
+#define SECTION_STRIDE_Z CHUNK_SIZE
+#else
+#define SECTION_INDEX(x, y, z) \
+    (((x) * CHUNK_SECTION_HEIGHT + (y)) * CHUNK_SIZE + (z))
+#define SECTION_X(i) ((i) / (CHUNK_SECTION_HEIGHT * CHUNK_SIZE))
+#define SECTION_Y(i) (((i) / CHUNK_SIZE) % CHUNK_SECTION_HEIGHT)
+#define SECTION_Z(i) ((i) % CHUNK_SIZE)
+#define SECTION_STRIDE_X (CHUNK_SECTION_HEIGHT * CHUNK_SIZE)
+#define SECTION_STRIDE_Y CHUNK_SIZE
+#define SECTION_STRIDE_Z 1
+#endif
+
+typedef struct ChunkSection ChunkSection;
+
+#if CHUNK_PALETTE_STORAGE
+// Blocks are packed palette indices of 1, 2, 4 or 8 bits, so an index
+// never straddles two words. The palette grows on demand and never holds
+// duplicates, so it can't exceed BLOCK_COUNT entries.
+struct ChunkSection {
+    int block_count;                        // Non-air blocks
+    int bits;
+    int palette_size;
+    uint8_t palette[BLOCK_COUNT];
+    uint64_t* data;                         // CHUNK_SECTION_VOLUME * bits / 64 words
+    ChunkSection* next_free;
+};
+#else
+struct ChunkSection {
+    int block_count;                        // Non-air blocks
+    uint8_t blocks[CHUNK_SECTION_VOLUME];
+    ChunkSection* next_free;
+};
+#endif
+
 typedef struct Chunk Chunk;
 
+// Lifecycle of a chunk streamed in by the job system. Only the main thread
+// changes it; a chunk in GENERATING or MESHING is referenced by a worker job
+// and must not be unloaded.
+typedef enum {
+    CHUNK_STATE_QUEUED,         // Waiting for a generation job
+    CHUNK_STATE_GENERATING,     // Terrain being written by a worker
+    CHUNK_STATE_GENERATED,      // Blocks published, no mesh yet
+    CHUNK_STATE_MESHING,        // Vertices being built from a snapshot
+    CHUNK_STATE_READY           // Mesh uploaded
+} ChunkState;
+
 struct Chunk {
     int x, z;
-    uint8_t blocks[CHUNK_SIZE][CHUNK_HEIGHT][CHUNK_SIZE];
+    // A NULL section is uniformly filled with section_fill (usually air)
+    ChunkSection* sections[CHUNK_SECTION_COUNT];
+    uint8_t section_fill[CHUNK_SECTION_COUNT];
+    ChunkState state;
     bool is_generated;
     bool is_dirty;
+    bool is_modified;       // Edited since it was last written to the save
+    bool save_failed;       // Last write failed, stays loaded until one succeeds
+    bool is_saving;         // A save job holds a copy, stays loaded until it's back
+    // Which faces of each section see each other, see visibility.h. A
+    // stale section's blocks changed since, it's recomputed when meshed.
+    uint16_t section_graph[CHUNK_SECTION_COUNT];
+    uint16_t graph_stale;
+    uint32_t visibility_frame;  // Last traversal that reached the chunk
+    uint16_t visible_sections;  // and the sections it reached
     Chunk* north;
     Chunk* south;
     Chunk* east;
@@ -21,10 +102,20 @@ struct Chunk {
 };
 
 Chunk* chunk_create(int x, int z);
+void chunk_reset(Chunk* chunk, int x, int z);
 void chunk_destroy(Chunk* chunk);
 BlockType chunk_get_block(Chunk* chunk, int x, int y, int z);
 void chunk_set_block(Chunk* chunk, int x, int y, int z, BlockType type);
 BlockType chunk_get_neighbor_block(Chunk* chunk, int x, int y, int z);
 bool chunk_is_block_visible(Chunk* chunk, int x, int y, int z);
+bool chunk_section_is_empty(Chunk* chunk, int section_y);
+void chunk_read_section(Chunk* chunk, int section_y, uint8_t* out_blocks);
+void chunk_read_column(Chunk* chunk, int section_y, int x, int z, uint8_t* out_blocks);
+void chunk_write_section(Chunk* chunk, int section_y, const uint8_t* blocks);
+bool chunk_copy_blocks(Chunk* dst, const Chunk* src);
+uint16_t chunk_section_graph(const Chunk* chunk, int section_y);
+void chunk_update_graph(Chunk* chunk, int section_y, const uint8_t* blocks);
+void chunk_take_graphs(Chunk* chunk, const Chunk* snapshot);
+size_t chunk_memory_usage(Chunk* chunk);
 
 #endif
\ No newline at end of file
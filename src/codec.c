@@ -0,0 +1,236 @@
+#include "codec.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_RUN_LENGTH 256
+
+// Edit positions don't depend on CHUNK_LAYOUT, so saves outlive it
+#define EDIT_POSITION(x, y, z) (((y) * CHUNK_SIZE + (z)) * CHUNK_SIZE + (x))
+
+CodecScratch* codec_scratch_create(void) {
+    // Zeroed so the terrain chunk starts out without sections
+    return (CodecScratch*)calloc(1, sizeof(CodecScratch));
+}
+
+void codec_scratch_destroy(CodecScratch* scratch) {
+    if (!scratch) return;
+    
+    chunk_reset(&scratch->terrain, 0, 0);
+    free(scratch);
+}
+
+static size_t encode_runs(uint8_t* out, CodecScratch* scratch) {
+    // Terrain is layered, so a column is only a handful of runs, and
+    // neighboring columns repeat each other for the compressor to find
+    uint8_t* runs = scratch->runs;
+    for (int x = 0; x < CHUNK_SIZE; x++) {
+        for (int z = 0; z < CHUNK_SIZE; z++) {
+            int y = 0;
+            while (y < CHUNK_HEIGHT) {
+                uint8_t block = scratch->blocks[y / CHUNK_SECTION_HEIGHT]
+                    [SECTION_INDEX(x, y % CHUNK_SECTION_HEIGHT, z)];
+                int length = 1;
+                while (y + length < CHUNK_HEIGHT && length < MAX_RUN_LENGTH &&
+                       scratch->blocks[(y + length) / CHUNK_SECTION_HEIGHT]
+                           [SECTION_INDEX(x, (y + length) % CHUNK_SECTION_HEIGHT, z)] == block) {
+                    length++;
+                }
+                *runs++ = block;
+                *runs++ = (uint8_t)(length - 1);
+                y += length;
+            }
+        }
+    }
+    
+    uint32_t runs_size = (uint32_t)(runs - scratch->runs);
+    out[1] = CODEC_RECORD_RUNS;
+    memcpy(out + CODEC_HEADER_SIZE, &runs_size, sizeof(runs_size));
+    
+    size_t payload = CODEC_HEADER_SIZE + sizeof(runs_size);
+    return payload + lz_compress(scratch->runs, runs_size, out + payload,
+                                 CODEC_MAX_SIZE - payload);
+}
+
+// Record size, or 0 if the chunk differs from its terrain in more than
+// CODEC_MAX_EDITS blocks
+static size_t encode_edits(Chunk* chunk, TerrainGenerator* terrain, uint8_t* out,
+                           CodecScratch* scratch) {
+    chunk_reset(&scratch->terrain, chunk->x, chunk->z);
+    terrain_generate_chunk(terrain, &scratch->terrain);
+    
+    uint8_t* edits = out + CODEC_HEADER_SIZE + sizeof(uint16_t);
+    int count = 0;
+    
+    for (int sy = 0; sy < CHUNK_SECTION_COUNT; sy++) {
+        // Untouched air and solid sections are the same fill on both sides
+        if (!chunk->sections[sy] && !scratch->terrain.sections[sy] &&
+            chunk->section_fill[sy] == scratch->terrain.section_fill[sy]) {
+            continue;
+        }
+        
+        const uint8_t* blocks = scratch->blocks[sy];
+        uint8_t* original = scratch->terrain_blocks[sy];
+        chunk_read_section(&scratch->terrain, sy, original);
+        
+        // Eight blocks per step, edits are rare
+        for (int i = 0; i < CHUNK_SECTION_VOLUME; i += 8) {
+            uint64_t a, b;
+            memcpy(&a, blocks + i, sizeof(a));
+            memcpy(&b, original + i, sizeof(b));
+            if (a == b) continue;
+            
+            for (int j = i; j < i + 8; j++) {
+                if (blocks[j] == original[j]) continue;
+                if (count == CODEC_MAX_EDITS) {
+                    chunk_reset(&scratch->terrain, 0, 0);
+                    return 0;
+                }
+                
+                uint16_t position = (uint16_t)EDIT_POSITION(
+                    SECTION_X(j), sy * CHUNK_SECTION_HEIGHT + SECTION_Y(j), SECTION_Z(j));
+                memcpy(edits, &position, sizeof(position));
+                edits[2] = blocks[j];
+                edits += CODEC_EDIT_SIZE;
+                count++;
+            }
+        }
+    }
+    
+    chunk_reset(&scratch->terrain, 0, 0);
+    
+    uint16_t edit_count = (uint16_t)count;
+    out[1] = CODEC_RECORD_EDITS;
+    memcpy(out + CODEC_HEADER_SIZE, &edit_count, sizeof(edit_count));
+    return (size_t)(edits - out);
+}
+
+// Record size, at most CODEC_MAX_SIZE. With a terrain generator, a lightly
+// edited chunk is stored as its edits alone.
+size_t codec_encode_chunk(Chunk* chunk, TerrainGenerator* terrain, uint8_t* out,
+                          CodecScratch* scratch) {
+    for (int sy = 0; sy < CHUNK_SECTION_COUNT; sy++) {
+        chunk_read_section(chunk, sy, scratch->blocks[sy]);
+    }
+    
+    out[0] = CHUNK_CODEC_VERSION;
+    
+    if (terrain) {
+        size_t length = encode_edits(chunk, terrain, out, scratch);
+        if (length) return length;
+    }
+    
+    return encode_runs(out, scratch);
+}
+
+static bool decode_runs(Chunk* chunk, const uint8_t* data, size_t length,
+                        CodecScratch* scratch) {
+    uint32_t runs_size;
+    if (length < sizeof(runs_size)) return false;
+    memcpy(&runs_size, data, sizeof(runs_size));
+    if (runs_size > CODEC_RUNS_MAX_SIZE) return false;
+    
+    long decompressed = lz_decompress(data + sizeof(runs_size), length - sizeof(runs_size),
+                                      scratch->runs, runs_size);
+    if (decompressed != (long)runs_size) return false;
+    
+    const uint8_t* runs = scratch->runs;
+    const uint8_t* runs_end = runs + runs_size;
+    
+    for (int x = 0; x < CHUNK_SIZE; x++) {
+        for (int z = 0; z < CHUNK_SIZE; z++) {
+            int y = 0;
+            while (y < CHUNK_HEIGHT) {
+                if (runs_end - runs < 2) return false;
+                uint8_t block = runs[0];
+                int run_length = runs[1] + 1;
+                runs += 2;
+                if (block >= BLOCK_COUNT || y + run_length > CHUNK_HEIGHT) return false;
+                
+                // One piece per section the run crosses
+                for (int end = y + run_length; y < end;) {
+                    int local_y = y % CHUNK_SECTION_HEIGHT;
+                    int count = CHUNK_SECTION_HEIGHT - local_y;
+                    if (count > end - y) count = end - y;
+                    
+                    uint8_t* out = &scratch->blocks[y / CHUNK_SECTION_HEIGHT]
+                                                   [SECTION_INDEX(x, local_y, z)];
+                    if (SECTION_STRIDE_Y == 1) {
+                        memset(out, block, count);
+                    } else {
+                        for (int i = 0; i < count; i++) out[i * SECTION_STRIDE_Y] = block;
+                    }
+                    y += count;
+                }
+            }
+        }
+    }
+    if (runs != runs_end) return false;
+    
+    for (int sy = 0; sy < CHUNK_SECTION_COUNT; sy++) {
+        chunk_write_section(chunk, sy, scratch->blocks[sy]);
+    }
+    
+    return true;
+}
+
+static bool decode_edits(Chunk* chunk, TerrainGenerator* terrain, const uint8_t* data,
+                         size_t length, CodecScratch* scratch) {
+    uint16_t count;
+    if (!terrain || length < sizeof(count)) return false;
+    memcpy(&count, data, sizeof(count));
+    if (count > CODEC_MAX_EDITS || length != sizeof(count) + (size_t)count * CODEC_EDIT_SIZE) {
+        return false;
+    }
+    
+    const uint8_t* edits = data + sizeof(count);
+    for (int i = 0; i < count; i++) {
+        if (edits[i * CODEC_EDIT_SIZE + 2] >= BLOCK_COUNT) return false;
+    }
+    
+    terrain_generate_chunk(terrain, chunk);
+    
+    // Replay the edits on the sections they touch
+    uint32_t touched = 0;
+    for (int i = 0; i < count; i++, edits += CODEC_EDIT_SIZE) {
+        uint16_t position;
+        memcpy(&position, edits, sizeof(position));
+        
+        int x = position % CHUNK_SIZE;
+        int z = (position / CHUNK_SIZE) % CHUNK_SIZE;
+        int y = position / (CHUNK_SIZE * CHUNK_SIZE);
+        int sy = y / CHUNK_SECTION_HEIGHT;
+        
+        if (!(touched & (1u << sy))) {
+            chunk_read_section(chunk, sy, scratch->blocks[sy]);
+            touched |= 1u << sy;
+        }
+        scratch->blocks[sy][SECTION_INDEX(x, y % CHUNK_SECTION_HEIGHT, z)] = edits[2];
+    }
+    
+    for (int sy = 0; sy < CHUNK_SECTION_COUNT; sy++) {
+        if (touched & (1u << sy)) {
+            chunk_write_section(chunk, sy, scratch->blocks[sy]);
+        }
+    }
+    
+    return true;
+}
+
+// Decode into a freshly reset chunk, false if the record is damaged, of
+// another version, or holds edits and there is no terrain to apply them to
+bool codec_decode_chunk(Chunk* chunk, TerrainGenerator* terrain, const uint8_t* data,
+                        size_t length, CodecScratch* scratch) {
+    if (length < CODEC_HEADER_SIZE || data[0] != CHUNK_CODEC_VERSION) return false;
+    
+    const uint8_t* payload = data + CODEC_HEADER_SIZE;
+    size_t payload_length = length - CODEC_HEADER_SIZE;
+    
+    switch (data[1]) {
+        case CODEC_RECORD_RUNS:
+            return decode_runs(chunk, payload, payload_length, scratch);
+        case CODEC_RECORD_EDITS:
+            return decode_edits(chunk, terrain, payload, payload_length, scratch);
+        default:
+            return false;
+    }
+}
\ No newline at end of file
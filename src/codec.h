@@ -0,0 +1,56 @@
+#ifndef CODEC_H
+#define CODEC_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "chunk.h"
+#include "terrain.h"
+#include "lz.h"
+
+// Saved chunk format. Bump the version when the layout changes, or when
+// terrain generation changes, since edit records are replayed on top of
+// regenerated terrain. Records of any other version fail to decode and
+// the chunk is generated again.
+#define CHUNK_CODEC_VERSION 2
+
+typedef enum {
+    CODEC_RECORD_RUNS,          // Every block, as compressed column runs
+    CODEC_RECORD_EDITS          // Only the blocks that differ from terrain
+} CodecRecordType;
+
+// Version byte and record type
+#define CODEC_HEADER_SIZE 2
+
+// Each column is stored bottom to top as (block, run length - 1) byte
+// pairs, so the worst case is one pair per block
+#define CODEC_RUNS_MAX_SIZE (CHUNK_SIZE * CHUNK_SIZE * CHUNK_HEIGHT * 2)
+
+// Edits are a 16-bit block position and the new block. Chunks edited more
+// than this are stored whole instead.
+#define CODEC_EDIT_SIZE 3
+#define CODEC_MAX_EDITS 1024
+
+#if CHUNK_SIZE * CHUNK_SIZE * CHUNK_HEIGHT > 65536
+#error "Edit positions need more than 16 bits"
+#endif
+
+#define CODEC_MAX_SIZE (CODEC_HEADER_SIZE + sizeof(uint32_t) + \
+                        LZ_COMPRESS_BOUND(CODEC_RUNS_MAX_SIZE))
+
+// Working memory for one encode or decode, reused between calls
+typedef struct {
+    uint8_t blocks[CHUNK_SECTION_COUNT][CHUNK_SECTION_VOLUME];
+    uint8_t terrain_blocks[CHUNK_SECTION_COUNT][CHUNK_SECTION_VOLUME];
+    uint8_t runs[CODEC_RUNS_MAX_SIZE];
+    Chunk terrain;              // Regenerated terrain to diff against
+} CodecScratch;
+
+CodecScratch* codec_scratch_create(void);
+void codec_scratch_destroy(CodecScratch* scratch);
+size_t codec_encode_chunk(Chunk* chunk, TerrainGenerator* terrain, uint8_t* out,
+                          CodecScratch* scratch);
+bool codec_decode_chunk(Chunk* chunk, TerrainGenerator* terrain, const uint8_t* data,
+                        size_t length, CodecScratch* scratch);
+
+#endif
\ No newline at end of file
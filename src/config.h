@@ -12,11 +12,22 @@
 #define RENDER_DISTANCE 8
 #define SEA_LEVEL 64
 
+// Store chunk sections as palette indices instead of one byte per block
+#define CHUNK_PALETTE_STORAGE 1
+
+// Block order inside a chunk section, axes named outermost to innermost
+#define CHUNK_LAYOUT_XYZ 0   // z innermost
+#define CHUNK_LAYOUT_XZY 1   // y innermost, vertical columns are contiguous
+#define CHUNK_LAYOUT_YZX 2   // x innermost, horizontal slices are contiguous
+#ifndef CHUNK_LAYOUT
+#define CHUNK_LAYOUT CHUNK_LAYOUT_XZY
+#endif
+
 #define TERRAIN_OCTAVES 6
 #define TERRAIN_PERSISTENCE 0.5f
 #define TERRAIN_LACUNARITY 2.0f
 #define TERRAIN_SCALE 0.02f
-#define TERRAIN_HEIGHT_MULTIPLIER 40
+#define TERRAIN_HEIGHT_MULTIPLIER 92
 #define TERRAIN_BASE 50
 
 #define PLAYER_HEIGHT 1.8f
@@ -34,7 +45,20 @@
 #define REACH_DISTANCE 5.0f
 #define BLOCK_PLACE_COOLDOWN 0.25f
 
-#define MAX_CHUNKS_PER_FRAME 4
+// Generation and vertex building run on worker threads; the main thread
+// only publishes results and uploads at most this many meshes per frame
+#define JOB_WORKER_COUNT 3
+#define MAX_GENERATION_JOBS 16
+#define MAX_MESH_JOBS 16
+#define MAX_MESH_UPLOADS_PER_FRAME 8
+
+// Seconds between background saves of edited chunks
+#define AUTOSAVE_INTERVAL 30.0f
+
+// Chunks are unloaded only once they are this many chunks beyond
+// RENDER_DISTANCE, so walking back and forth over a border doesn't thrash
+#define CHUNK_UNLOAD_MARGIN 2
+#define MAX_CHUNK_UNLOADS_PER_FRAME 32
 
 #ifndef M_PI
 #define M_PI 3.14159265358979323846
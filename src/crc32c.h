@@ -0,0 +1,11 @@
+#ifndef CRC32C_H
+#define CRC32C_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// CRC-32C (Castagnoli), the checksum of saved records. Uses the SSE4.2
+// crc32 instruction when the CPU has it, else a lookup table.
+uint32_t crc32c(const void* data, size_t length);
+
+#endif
\ No newline at end of file
@@ -4,10 +4,260 @@
 
 #include "engine.h"
 #include "config.h"
+#include "mesh.h"
+#include "terrain.h"
 #include <stdlib.h>
 #include <stdio.h>
 #include <math.h>
 
+typedef enum {
+    CHUNK_JOB_GENERATE,
+    CHUNK_JOB_MESH,
+    CHUNK_JOB_SAVE
+} ChunkJobType;
+
+typedef struct ChunkJob {
+    Job job;
+    ChunkJobType type;
+    Chunk* chunk;
+    World* world;
+    // Mesh jobs read private copies of the chunk and its four neighbors,
+    // so the live chunks can keep changing on the main thread. Save jobs
+    // write a copy of the chunk alone.
+    Chunk snapshot[5];
+    MeshMode mode;
+    MeshData mesh;
+    bool mesh_ok;
+    bool autosave;
+    size_t saved_bytes;
+    struct ChunkJob* next_free;
+} ChunkJob;
+
+// Runs on a worker thread
+static void run_chunk_job(Job* job) {
+    ChunkJob* chunk_job = (ChunkJob*)job;
+    
+    if (chunk_job->type == CHUNK_JOB_GENERATE) {
+        world_fill_chunk(chunk_job->world, chunk_job->chunk);
+    } else if (chunk_job->type == CHUNK_JOB_SAVE) {
+        World* world = chunk_job->world;
+        chunk_job->saved_bytes = region_write_chunk(world->store, &chunk_job->snapshot[0],
+                                                    (TerrainGenerator*)world->terrain_gen);
+        region_store_flush(world->store);
+    } else {
+        chunk_job->mesh_ok = mesh_generate(&chunk_job->snapshot[0], chunk_job->mode,
+                                           &chunk_job->mesh);
+    }
+}
+
+static ChunkJob* take_job(Engine* engine) {
+    ChunkJob* job = engine->free_jobs;
+    if (job) {
+        engine->free_jobs = job->next_free;
+    } else {
+        // Zeroed so the snapshot chunks start out without sections
+        job = (ChunkJob*)calloc(1, sizeof(ChunkJob));
+        if (!job) return NULL;
+    }
+    
+    job->job.run = run_chunk_job;
+    job->next_free = NULL;
+    return job;
+}
+
+static void recycle_job(Engine* engine, ChunkJob* job) {
+    for (int i = 0; i < 5; i++) {
+        chunk_reset(&job->snapshot[i], 0, 0);
+    }
+    job->chunk = NULL;
+    job->next_free = engine->free_jobs;
+    engine->free_jobs = job;
+}
+
+// Copy the chunk and its generated neighbors into the job. Neighbors that
+// are still generating are left out and read as air, like missing ones.
+static bool snapshot_chunk(ChunkJob* job, Chunk* chunk) {
+    Chunk* snapshot = job->snapshot;
+    if (!chunk_copy_blocks(&snapshot[0], chunk)) return false;
+    
+    Chunk* neighbors[4] = {chunk->north, chunk->south, chunk->east, chunk->west};
+    Chunk* copies[4] = {NULL, NULL, NULL, NULL};
+    for (int i = 0; i < 4; i++) {
+        if (neighbors[i] && neighbors[i]->is_generated) {
+            if (!chunk_copy_blocks(&snapshot[i + 1], neighbors[i])) return false;
+            copies[i] = &snapshot[i + 1];
+        }
+    }
+    
+    snapshot[0].north = copies[0];
+    snapshot[0].south = copies[1];
+    snapshot[0].east = copies[2];
+    snapshot[0].west = copies[3];
+    return true;
+}
+
+static void engine_dispatch_jobs(Engine* engine) {
+    World* world = engine->world;
+    
+    // Generate the nearest queued chunks first
+    Chunk* chunks[MAX_GENERATION_JOBS + MAX_MESH_JOBS];
+    int count = world_get_queued_chunks(world,
+                                        engine->player->position[0],
+                                        engine->player->position[2],
+                                        chunks,
+                                        MAX_GENERATION_JOBS - engine->generation_jobs);
+    
+    for (int i = 0; i < count; i++) {
+        ChunkJob* job = take_job(engine);
+        if (!job) break;
+        
+        job->type = CHUNK_JOB_GENERATE;
+        job->chunk = chunks[i];
+        job->world = world;
+        
+        chunks[i]->state = CHUNK_STATE_GENERATING;
+        engine->generation_jobs++;
+        jobs_submit(engine->jobs, &job->job);
+    }
+    
+    count = world_get_dirty_chunks(world, chunks, MAX_MESH_JOBS - engine->mesh_jobs);
+    
+    for (int i = 0; i < count; i++) {
+        ChunkJob* job = take_job(engine);
+        if (!job) break;
+        
+        if (!snapshot_chunk(job, chunks[i])) {
+            recycle_job(engine, job);
+            break;
+        }
+        
+        job->type = CHUNK_JOB_MESH;
+        job->chunk = chunks[i];
+        job->mode = engine->renderer->greedy_meshing ? MESH_MODE_GREEDY : MESH_MODE_NAIVE;
+        
+        // Edits made while the job runs mark the chunk dirty again
+        chunks[i]->state = CHUNK_STATE_MESHING;
+        chunks[i]->is_dirty = false;
+        engine->mesh_jobs++;
+        jobs_submit(engine->jobs, &job->job);
+    }
+}
+
+// Hand a copy of an edited chunk to the workers for writing. Until the
+// write finishes the chunk isn't unloaded or saved again: it isn't marked
+// modified anymore, reloading it could read the save before its record
+// lands, and a second write could land before the first.
+static bool engine_save_chunk(Engine* engine, Chunk* chunk, bool autosave) {
+    ChunkJob* job = take_job(engine);
+    if (!job) return false;
+    
+    if (!chunk_copy_blocks(&job->snapshot[0], chunk)) {
+        recycle_job(engine, job);
+        return false;
+    }
+    
+    job->type = CHUNK_JOB_SAVE;
+    job->chunk = chunk;
+    job->world = engine->world;
+    job->autosave = autosave;
+    
+    // Edits made while the job runs mark the chunk modified again
+    chunk->is_modified = false;
+    chunk->is_saving = true;
+    engine->save_jobs++;
+    if (autosave) engine->autosave_jobs++;
+    jobs_submit(engine->jobs, &job->job);
+    return true;
+}
+
+// Save every edited chunk in the background
+static void engine_start_autosave(Engine* engine) {
+    World* world = engine->world;
+    if (!world->store || engine->autosave_jobs > 0) return;
+    
+    double start = glfwGetTime();
+    
+    for (int i = 0; i < world->chunk_count; i++) {
+        Chunk* chunk = world->chunks[i];
+        if (!chunk->is_generated || !chunk->is_modified || chunk->is_saving) continue;
+        if (!engine_save_chunk(engine, chunk, true)) break;
+    }
+    
+    if (engine->autosave_jobs == 0) return;
+    
+    engine->autosave_start = start;
+    engine->autosave_chunks = engine->autosave_jobs;
+    engine->autosave_bytes = 0;
+    printf("Autosave: %d chunks copied in %.2f ms\n",
+           engine->autosave_jobs, (glfwGetTime() - start) * 1000.0);
+}
+
+// Apply finished jobs until upload_budget non-empty meshes went to the GPU.
+// Without apply, results are thrown away.
+static void engine_collect_jobs(Engine* engine, int upload_budget, bool apply) {
+    int uploads = 0;
+    
+    while (uploads < upload_budget) {
+        ChunkJob* job = (ChunkJob*)jobs_poll(engine->jobs);
+        if (!job) break;
+        
+        Chunk* chunk = job->chunk;
+        if (job->type == CHUNK_JOB_GENERATE) {
+            engine->generation_jobs--;
+            if (apply) world_publish_chunk(engine->world, chunk);
+        } else if (job->type == CHUNK_JOB_SAVE) {
+            engine->save_jobs--;
+            chunk->is_saving = false;
+            
+            // Kept loaded for the next autosave to try again
+            if (job->saved_bytes) {
+                chunk->save_failed = false;
+            } else {
+                fprintf(stderr, "Failed to save chunk (%d, %d), keeping it loaded\n",
+                        chunk->x, chunk->z);
+                chunk->is_modified = true;
+                chunk->save_failed = true;
+            }
+            
+            if (job->autosave) {
+                engine->autosave_jobs--;
+                engine->autosave_bytes += job->saved_bytes;
+                
+                if (engine->autosave_jobs == 0) {
+                    printf("Autosave: %d chunks, %.1f KiB written in %.1f ms\n",
+                           engine->autosave_chunks, engine->autosave_bytes / 1024.0,
+                           (glfwGetTime() - engine->autosave_start) * 1000.0);
+                }
+            }
+        } else {
+            engine->mesh_jobs--;
+            chunk->state = CHUNK_STATE_READY;
+            
+            if (apply && job->mesh_ok) {
+                chunk_take_graphs(chunk, &job->snapshot[0]);
+                double start = glfwGetTime();
+                if (!renderer_upload_chunk_mesh(engine->renderer, chunk, &job->mesh)) {
+                    chunk->is_dirty = true;
+                }
+                engine->upload_seconds += glfwGetTime() - start;
+                if (job->mesh.vertex_count > 0) uploads++;
+            } else {
+                chunk->is_dirty = true;
+            }
+            
+            if (job->mesh_ok) mesh_data_free(&job->mesh);
+        }
+        
+        recycle_job(engine, job);
+    }
+}
+
+// Wait for every job in flight and handle its result now
+static void engine_drain_jobs(Engine* engine, bool apply) {
+    jobs_wait_idle(engine->jobs);
+    engine_collect_jobs(engine, MAX_GENERATION_JOBS + MAX_MESH_JOBS, apply);
+}
+
 Engine* engine_create(GLFWwindow* window) {
     Engine* engine = (Engine*)malloc(sizeof(Engine));
     if (!engine) return NULL;
@@ -20,6 +270,13 @@ Engine* engine_create(GLFWwindow* window) {
     engine->fps = 0;
     engine->show_debug = false;
     engine->last_block_action = 0.0;
+    engine->free_jobs = NULL;
+    engine->generation_jobs = 0;
+    engine->mesh_jobs = 0;
+    engine->save_jobs = 0;
+    engine->autosave_jobs = 0;
+    engine->autosave_timer = 0.0f;
+    engine->upload_seconds = 0.0;
     
     blocks_init();
     
@@ -28,6 +285,12 @@ Engine* engine_create(GLFWwindow* window) {
         free(engine);
         return NULL;
     }
+    engine->world->async_generation = true;
+    
+    // Continue the saved world if there is one
+    if (!world_open(engine->world, "saves/world")) {
+        fprintf(stderr, "Saving disabled, edited chunks stay loaded\n");
+    }
     
     engine->player = player_create(engine->world, 0.0f, 100.0f, 0.0f);
     if (!engine->player) {
@@ -46,11 +309,29 @@ Engine* engine_create(GLFWwindow* window) {
         return NULL;
     }
     
+    engine->jobs = jobs_create(JOB_WORKER_COUNT);
+    if (!engine->jobs) {
+        renderer_destroy(engine->renderer);
+        player_destroy(engine->player);
+        world_destroy(engine->world);
+        free(engine);
+        return NULL;
+    }
+    
     return engine;
 }
 
 void engine_destroy(Engine* engine) {
     if (engine) {
+        // Workers must be done with the world before it goes away
+        engine_drain_jobs(engine, false);
+        jobs_destroy(engine->jobs);
+        while (engine->free_jobs) {
+            ChunkJob* job = engine->free_jobs;
+            engine->free_jobs = job->next_free;
+            free(job);
+        }
+        
         renderer_destroy(engine->renderer);
         player_destroy(engine->player);
         world_destroy(engine->world);
@@ -61,33 +342,57 @@ void engine_destroy(Engine* engine) {
 void engine_update(Engine* engine, float dt) {
     if (!engine) return;
     
-    player_update(engine->player, dt);
+    // Terrain arrives asynchronously, hold the player until the ground
+    // under them exists instead of letting them fall through it
+    Chunk* ground = world_find_chunk(engine->world,
+                                     (int)floor(engine->player->position[0] / CHUNK_SIZE),
+                                     (int)floor(engine->player->position[2] / CHUNK_SIZE));
+    if (ground && ground->is_generated) {
+        player_update(engine->player, dt);
+    }
+    
+    // Release chunks that drifted out of range before loading new ones
+    Chunk* distant_chunks[MAX_CHUNK_UNLOADS_PER_FRAME];
+    int distant_count = world_get_distant_chunks(engine->world,
+                                                 engine->player->position[0],
+                                                 engine->player->position[2],
+                                                 distant_chunks,
+                                                 MAX_CHUNK_UNLOADS_PER_FRAME);
+    
+    for (int i = 0; i < distant_count; i++) {
+        Chunk* chunk = distant_chunks[i];
+        
+        // Edited chunks are written by a worker first and go on a later
+        // frame, once the job is back
+        if (chunk->is_modified) {
+            engine_save_chunk(engine, chunk, false);
+            continue;
+        }
+        
+        renderer_destroy_chunk_mesh(chunk);
+        world_unload_chunk(engine->world, chunk);
+    }
     
     world_update_chunks(engine->world, 
                        engine->player->position[0],
                        engine->player->position[2]);
     
-    Chunk* dirty_chunks[MAX_CHUNKS_PER_FRAME];
-    int dirty_count = world_get_dirty_chunks(engine->world, dirty_chunks, 
-                                            MAX_CHUNKS_PER_FRAME);
+    engine_collect_jobs(engine, MAX_MESH_UPLOADS_PER_FRAME, true);
     
-    for (int i = 0; i < dirty_count; i++) {
-        renderer_build_chunk_mesh(engine->renderer, dirty_chunks[i]);
+    engine->autosave_timer += dt;
+    if (engine->autosave_timer >= AUTOSAVE_INTERVAL) {
+        engine->autosave_timer = 0.0f;
+        engine_start_autosave(engine);
     }
+    
+    engine_dispatch_jobs(engine);
 }
 
 void engine_render(Engine* engine) {
     if (!engine) return;
     
     renderer_begin(engine->renderer, engine->player);
-    
-    for (int i = 0; i < engine->world->chunk_count; i++) {
-        Chunk* chunk = engine->world->chunks[i];
-        if (chunk && chunk->is_generated && chunk->mesh) {
-            renderer_render_chunk(engine->renderer, chunk);
-        }
-    }
-    
+    renderer_render_chunks(engine->renderer, engine->world);
     renderer_end(engine->renderer);
     
     renderer_draw_crosshair(engine->renderer);
@@ -130,15 +435,66 @@ void engine_key_callback(Engine* engine, int key, int action, int mods) {
         } else if (key == GLFW_KEY_F3) {
             engine->show_debug = !engine->show_debug;
             engine->renderer->show_debug = engine->show_debug;
+            
+            if (engine->show_debug && engine->world->chunk_count > 0) {
+                size_t chunk_memory = 0;
+                for (int i = 0; i < engine->world->chunk_count; i++) {
+                    chunk_memory += chunk_memory_usage(engine->world->chunks[i]);
+                }
+                printf("Chunk memory: %.1f KiB total, %.1f KiB per chunk\n",
+                       chunk_memory / 1024.0,
+                       chunk_memory / 1024.0 / engine->world->chunk_count);
+            }
+            
+            if (engine->show_debug) {
+                ArenaStats stats;
+                mesh_get_arena_stats(&stats);
+                printf("Mesh arena: %.1f/%.1f MiB in %d meshes, %d free ranges, "
+                       "%.0f%% of free space fragmented\n",
+                       stats.used * 4 * sizeof(MeshVertex) / (1024.0 * 1024.0),
+                       stats.capacity * 4 * sizeof(MeshVertex) / (1024.0 * 1024.0),
+                       stats.allocations, stats.free_ranges, stats.fragmentation * 100.0f);
+                
+                MeshUploadStats uploads;
+                mesh_get_upload_stats(&uploads);
+                double megabytes = uploads.bytes / (1024.0 * 1024.0);
+                printf("Mesh uploads: %d, %.1f MiB at %.0f MiB/s through %s, %d stalls\n",
+                       uploads.uploads, megabytes,
+                       engine->upload_seconds > 0.0 ? megabytes / engine->upload_seconds : 0.0,
+                       uploads.persistent ? "the mapped ring" : "glBufferSubData",
+                       uploads.stalls);
+            }
+        } else if (key == GLFW_KEY_F4) {
+            engine->renderer->greedy_meshing = !engine->renderer->greedy_meshing;
+            printf("Greedy meshing %s\n", engine->renderer->greedy_meshing ? "on" : "off");
+            
+            // Rebuild every mesh in the new mode
+            for (int i = 0; i < engine->world->chunk_count; i++) {
+                engine->world->chunks[i]->is_dirty = true;
+            }
         } else if (key == GLFW_KEY_F5) {
-            world_save(engine->world, "saves/world.dat");
+            // Save jobs still writing older copies must not land after
+            // this save
+            if (engine->save_jobs > 0) engine_drain_jobs(engine, true);
+            world_save(engine->world);
+        } else if (key == GLFW_KEY_F6) {
+            engine->renderer->occlusion_culling = !engine->renderer->occlusion_culling;
+            printf("Occlusion culling %s\n",
+                   engine->renderer->occlusion_culling ? "on" : "off");
         } else if (key == GLFW_KEY_F9) {
-            if (world_load(engine->world, "saves/world.dat")) {
-                for (int i = 0; i < engine->world->chunk_count; i++) {
-                    Chunk* chunk = engine->world->chunks[i];
-                    if (chunk && chunk->is_generated) {
-                        chunk->is_dirty = true;
-                    }
+            // Loading recycles every chunk, so jobs using them and their
+            // meshes must go first
+            engine_drain_jobs(engine, true);
+            for (int i = 0; i < engine->world->chunk_count; i++) {
+                renderer_destroy_chunk_mesh(engine->world->chunks[i]);
+            }
+            
+            // Remesh whatever is resident, even if the load failed
+            world_load(engine->world);
+            for (int i = 0; i < engine->world->chunk_count; i++) {
+                Chunk* chunk = engine->world->chunks[i];
+                if (chunk && chunk->is_generated) {
+                    chunk->is_dirty = true;
                 }
             }
         }
@@ -6,12 +6,24 @@
 #include "world.h"
 #include "player.h"
 #include "renderer.h"
+#include "jobs.h"
 
 typedef struct {
     GLFWwindow* window;
     World* world;
     Player* player;
     Renderer* renderer;
+    JobSystem* jobs;
+    struct ChunkJob* free_jobs;
+    int generation_jobs;        // Submitted and not yet collected
+    int mesh_jobs;
+    int save_jobs;
+    int autosave_jobs;          // The part of save_jobs the last autosave started
+    float autosave_timer;
+    double autosave_start;
+    int autosave_chunks;
+    size_t autosave_bytes;
+    double upload_seconds;      // Main thread time spent uploading meshes
     bool mouse_captured;
     double last_mouse_x;
     double last_mouse_y;
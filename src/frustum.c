@@ -0,0 +1,105 @@
+#include "frustum.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Planes of a column-major projection * view matrix, each the sum or
+// difference of the w row and one of the x, y, z rows (Gribb & Hartmann).
+// Left unnormalized, only their sign is used.
+void frustum_from_matrix(Frustum* frustum, const float* clip) {
+    for (int i = 0; i < 6; i++) {
+        int row = i / 2;
+        float sign = (i % 2 == 0) ? 1.0f : -1.0f;
+        
+        for (int column = 0; column < 4; column++) {
+            frustum->planes[i][column] = clip[column * 4 + 3] + sign * clip[column * 4 + row];
+        }
+    }
+}
+
+void frustum_set_box(FrustumBoxes* boxes, int index, const float* min, const float* max) {
+    FrustumBoxes* batch = &boxes[index / FRUSTUM_LANES];
+    int lane = index % FRUSTUM_LANES;
+    
+    batch->min_x[lane] = min[0];
+    batch->min_y[lane] = min[1];
+    batch->min_z[lane] = min[2];
+    batch->max_x[lane] = max[0];
+    batch->max_y[lane] = max[1];
+    batch->max_z[lane] = max[2];
+}
+
+// Single-box form of the test below, for callers visiting boxes one at a
+// time
+bool frustum_test_box(const Frustum* frustum, const float* min, const float* max) {
+    for (int i = 0; i < 6; i++) {
+        const float* plane = frustum->planes[i];
+        float x = plane[0] >= 0.0f ? max[0] : min[0];
+        float y = plane[1] >= 0.0f ? max[1] : min[1];
+        float z = plane[2] >= 0.0f ? max[2] : min[2];
+        if (plane[0] * x + plane[1] * y + plane[2] * z + plane[3] < 0.0f) return false;
+    }
+    return true;
+}
+
+// A box is outside when its corner furthest along a plane's normal is
+// still behind that plane. Conservative: a box near a frustum corner can
+// pass though it's outside. Sets visible[i] for the count boxes and
+// returns how many are visible.
+int frustum_cull_boxes(const Frustum* frustum, const FrustumBoxes* boxes, int count,
+                       uint8_t* visible) {
+    int visible_count = 0;
+    
+    for (int base = 0; base < count; base += FRUSTUM_LANES) {
+        const FrustumBoxes* batch = &boxes[base / FRUSTUM_LANES];
+        int lanes = count - base < FRUSTUM_LANES ? count - base : FRUSTUM_LANES;
+        
+#if defined(__SSE2__)
+        __m128 min_x = _mm_loadu_ps(batch->min_x);
+        __m128 min_y = _mm_loadu_ps(batch->min_y);
+        __m128 min_z = _mm_loadu_ps(batch->min_z);
+        __m128 max_x = _mm_loadu_ps(batch->max_x);
+        __m128 max_y = _mm_loadu_ps(batch->max_y);
+        __m128 max_z = _mm_loadu_ps(batch->max_z);
+        __m128 outside = _mm_setzero_ps();
+        
+        for (int i = 0; i < 6; i++) {
+            const float* plane = frustum->planes[i];
+            
+            // The furthest corner is picked per plane, the same for all lanes
+            __m128 x = plane[0] >= 0.0f ? max_x : min_x;
+            __m128 y = plane[1] >= 0.0f ? max_y : min_y;
+            __m128 z = plane[2] >= 0.0f ? max_z : min_z;
+            
+            __m128 distance = _mm_add_ps(
+                _mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(plane[0])),
+                           _mm_mul_ps(y, _mm_set1_ps(plane[1]))),
+                _mm_add_ps(_mm_mul_ps(z, _mm_set1_ps(plane[2])),
+                           _mm_set1_ps(plane[3])));
+            outside = _mm_or_ps(outside, _mm_cmplt_ps(distance, _mm_setzero_ps()));
+        }
+        
+        int outside_mask = _mm_movemask_ps(outside);
+        for (int lane = 0; lane < lanes; lane++) {
+            visible[base + lane] = !(outside_mask & (1 << lane));
+            visible_count += visible[base + lane];
+        }
+#else
+        for (int lane = 0; lane < lanes; lane++) {
+            bool inside = true;
+            for (int i = 0; i < 6 && inside; i++) {
+                const float* plane = frustum->planes[i];
+                float x = plane[0] >= 0.0f ? batch->max_x[lane] : batch->min_x[lane];
+                float y = plane[1] >= 0.0f ? batch->max_y[lane] : batch->min_y[lane];
+                float z = plane[2] >= 0.0f ? batch->max_z[lane] : batch->min_z[lane];
+                inside = plane[0] * x + plane[1] * y + plane[2] * z + plane[3] >= 0.0f;
+            }
+            visible[base + lane] = inside;
+            visible_count += inside;
+        }
+#endif
+    }
+    
+    return visible_count;
+}
\ No newline at end of file
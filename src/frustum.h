@@ -0,0 +1,27 @@
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Boxes are tested FRUSTUM_LANES at a time, laid out so each coordinate
+// of a batch is one vector load
+#define FRUSTUM_LANES 4
+
+typedef struct {
+    float min_x[FRUSTUM_LANES], min_y[FRUSTUM_LANES], min_z[FRUSTUM_LANES];
+    float max_x[FRUSTUM_LANES], max_y[FRUSTUM_LANES], max_z[FRUSTUM_LANES];
+} FrustumBoxes;
+
+// Planes as (a, b, c, d), a point is inside when ax + by + cz + d >= 0
+typedef struct {
+    float planes[6][4];
+} Frustum;
+
+void frustum_from_matrix(Frustum* frustum, const float* clip);
+bool frustum_test_box(const Frustum* frustum, const float* min, const float* max);
+void frustum_set_box(FrustumBoxes* boxes, int index, const float* min, const float* max);
+int frustum_cull_boxes(const Frustum* frustum, const FrustumBoxes* boxes, int count,
+                       uint8_t* visible);
+
+#endif
\ No newline at end of file
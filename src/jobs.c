@@ -0,0 +1,137 @@
+#include "jobs.h"
+#include <stdlib.h>
+#include <stdio.h>
+
+static void queue_push(Job** head, Job** tail, Job* job) {
+    job->next = NULL;
+    if (*tail) {
+        (*tail)->next = job;
+    } else {
+        *head = job;
+    }
+    *tail = job;
+}
+
+static Job* queue_pop(Job** head, Job** tail) {
+    Job* job = *head;
+    if (job) {
+        *head = job->next;
+        if (!*head) *tail = NULL;
+        job->next = NULL;
+    }
+    return job;
+}
+
+static void* worker_main(void* arg) {
+    JobSystem* jobs = (JobSystem*)arg;
+    
+    pthread_mutex_lock(&jobs->lock);
+    for (;;) {
+        while (!jobs->pending_head && !jobs->stopping) {
+            pthread_cond_wait(&jobs->work_ready, &jobs->lock);
+        }
+        if (jobs->stopping) break;
+        
+        Job* job = queue_pop(&jobs->pending_head, &jobs->pending_tail);
+        jobs->running++;
+        pthread_mutex_unlock(&jobs->lock);
+        
+        job->run(job);
+        
+        pthread_mutex_lock(&jobs->lock);
+        jobs->running--;
+        queue_push(&jobs->done_head, &jobs->done_tail, job);
+        if (!jobs->pending_head && jobs->running == 0) {
+            pthread_cond_broadcast(&jobs->work_done);
+        }
+    }
+    pthread_mutex_unlock(&jobs->lock);
+    
+    return NULL;
+}
+
+JobSystem* jobs_create(int worker_count) {
+    JobSystem* jobs = (JobSystem*)malloc(sizeof(JobSystem));
+    if (!jobs) return NULL;
+    
+    if (worker_count < 1) worker_count = 1;
+    if (worker_count > MAX_JOB_WORKERS) worker_count = MAX_JOB_WORKERS;
+    
+    jobs->worker_count = 0;
+    jobs->pending_head = NULL;
+    jobs->pending_tail = NULL;
+    jobs->done_head = NULL;
+    jobs->done_tail = NULL;
+    jobs->running = 0;
+    jobs->stopping = false;
+    
+    pthread_mutex_init(&jobs->lock, NULL);
+    pthread_cond_init(&jobs->work_ready, NULL);
+    pthread_cond_init(&jobs->work_done, NULL);
+    
+    for (int i = 0; i < worker_count; i++) {
+        if (pthread_create(&jobs->workers[i], NULL, worker_main, jobs) != 0) {
+            fprintf(stderr, "Failed to start job worker %d\n", i);
+            break;
+        }
+        jobs->worker_count++;
+    }
+    
+    if (jobs->worker_count == 0) {
+        jobs_destroy(jobs);
+        return NULL;
+    }
+    
+    return jobs;
+}
+
+// Stops the workers once their current job is done. Jobs still queued are
+// dropped, so callers wait for idle and drain jobs_poll first.
+void jobs_destroy(JobSystem* jobs) {
+    if (!jobs) return;
+    
+    pthread_mutex_lock(&jobs->lock);
+    jobs->stopping = true;
+    pthread_cond_broadcast(&jobs->work_ready);
+    pthread_mutex_unlock(&jobs->lock);
+    
+    for (int i = 0; i < jobs->worker_count; i++) {
+        pthread_join(jobs->workers[i], NULL);
+    }
+    
+    pthread_cond_destroy(&jobs->work_done);
+    pthread_cond_destroy(&jobs->work_ready);
+    pthread_mutex_destroy(&jobs->lock);
+    free(jobs);
+}
+
+void jobs_submit(JobSystem* jobs, Job* job) {
+    if (!jobs || !job) return;
+    
+    pthread_mutex_lock(&jobs->lock);
+    queue_push(&jobs->pending_head, &jobs->pending_tail, job);
+    pthread_cond_signal(&jobs->work_ready);
+    pthread_mutex_unlock(&jobs->lock);
+}
+
+// Next finished job in completion order, or NULL if none is ready
+Job* jobs_poll(JobSystem* jobs) {
+    if (!jobs) return NULL;
+    
+    pthread_mutex_lock(&jobs->lock);
+    Job* job = queue_pop(&jobs->done_head, &jobs->done_tail);
+    pthread_mutex_unlock(&jobs->lock);
+    
+    return job;
+}
+
+// Block until every submitted job has finished running
+void jobs_wait_idle(JobSystem* jobs) {
+    if (!jobs) return;
+    
+    pthread_mutex_lock(&jobs->lock);
+    while (jobs->pending_head || jobs->running > 0) {
+        pthread_cond_wait(&jobs->work_done, &jobs->lock);
+    }
+    pthread_mutex_unlock(&jobs->lock);
+}
\ No newline at end of file
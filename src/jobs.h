@@ -0,0 +1,39 @@
+#ifndef JOBS_H
+#define JOBS_H
+
+#include <stdbool.h>
+#include <pthread.h>
+
+typedef struct Job Job;
+typedef void (*JobFunc)(Job* job);
+
+// Embedded as the first member of a job's payload. run() executes on a
+// worker thread; the finished job is handed back through jobs_poll.
+struct Job {
+    JobFunc run;
+    Job* next;
+};
+
+#define MAX_JOB_WORKERS 16
+
+typedef struct {
+    pthread_t workers[MAX_JOB_WORKERS];
+    int worker_count;
+    pthread_mutex_t lock;
+    pthread_cond_t work_ready;
+    pthread_cond_t work_done;
+    Job* pending_head;
+    Job* pending_tail;
+    Job* done_head;
+    Job* done_tail;
+    int running;
+    bool stopping;
+} JobSystem;
+
+JobSystem* jobs_create(int worker_count);
+void jobs_destroy(JobSystem* jobs);
+void jobs_submit(JobSystem* jobs, Job* job);
+Job* jobs_poll(JobSystem* jobs);
+void jobs_wait_idle(JobSystem* jobs);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,160 @@
+#include "lz.h"
+#include <string.h>
+
+#define LZ_MIN_MATCH 4
+#define LZ_MAX_OFFSET 65535
+#define LZ_HASH_BITS 13
+// The block always ends in literals, and matches stop this far before the
+// end, so the decoder's last sequence needs no offset
+#define LZ_LAST_LITERALS 5
+#define LZ_MATCH_LIMIT 12
+
+static inline uint32_t read32(const uint8_t* p) {
+    uint32_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+static inline uint32_t hash32(uint32_t value) {
+    return (value * 2654435761U) >> (32 - LZ_HASH_BITS);
+}
+
+// Lengths past the token's 4 bits continue in 255-valued bytes
+static uint8_t* write_length(uint8_t* out, const uint8_t* end, size_t length) {
+    while (length >= 255) {
+        if (out >= end) return NULL;
+        *out++ = 255;
+        length -= 255;
+    }
+    if (out >= end) return NULL;
+    *out++ = (uint8_t)length;
+    return out;
+}
+
+static uint8_t* write_sequence(uint8_t* out, const uint8_t* end,
+                               const uint8_t* literals, size_t literal_length,
+                               size_t offset, size_t match_length) {
+    if (out >= end) return NULL;
+    uint8_t* token = out++;
+    
+    size_t match_code = match_length ? match_length - LZ_MIN_MATCH : 0;
+    *token = (uint8_t)(((literal_length < 15 ? literal_length : 15) << 4) |
+                       (match_code < 15 ? match_code : 15));
+    
+    if (literal_length >= 15 && !(out = write_length(out, end, literal_length - 15))) {
+        return NULL;
+    }
+    if ((size_t)(end - out) < literal_length) return NULL;
+    memcpy(out, literals, literal_length);
+    out += literal_length;
+    
+    // The final sequence carries literals only
+    if (match_length == 0) return out;
+    
+    if (end - out < 2) return NULL;
+    *out++ = (uint8_t)(offset & 0xFF);
+    *out++ = (uint8_t)(offset >> 8);
+    
+    if (match_code >= 15 && !(out = write_length(out, end, match_code - 15))) {
+        return NULL;
+    }
+    return out;
+}
+
+// Compressed size, or 0 if dst is too small (LZ_COMPRESS_BOUND never is)
+size_t lz_compress(const uint8_t* src, size_t size, uint8_t* dst, size_t capacity) {
+    uint32_t table[1 << LZ_HASH_BITS];
+    memset(table, 0, sizeof(table));
+    
+    const uint8_t* end = dst + capacity;
+    uint8_t* out = dst;
+    size_t anchor = 0;
+    size_t pos = 0;
+    size_t limit = size > LZ_MATCH_LIMIT ? size - LZ_MATCH_LIMIT : 0;
+    size_t misses = 0;
+    
+    while (pos < limit) {
+        uint32_t h = hash32(read32(src + pos));
+        size_t candidate = table[h];
+        table[h] = (uint32_t)pos;
+        
+        if (candidate >= pos || pos - candidate > LZ_MAX_OFFSET ||
+            read32(src + candidate) != read32(src + pos)) {
+            // Skip faster through data that doesn't compress
+            pos += 1 + (misses++ >> 6);
+            continue;
+        }
+        misses = 0;
+        
+        size_t length = LZ_MIN_MATCH;
+        while (pos + length < size - LZ_LAST_LITERALS &&
+               src[candidate + length] == src[pos + length]) {
+            length++;
+        }
+        
+        out = write_sequence(out, end, src + anchor, pos - anchor, pos - candidate, length);
+        if (!out) return 0;
+        
+        pos += length;
+        anchor = pos;
+    }
+    
+    out = write_sequence(out, end, src + anchor, size - anchor, 0, 0);
+    return out ? (size_t)(out - dst) : 0;
+}
+
+static int read_length(const uint8_t** in, const uint8_t* end, size_t* length) {
+    uint8_t byte;
+    do {
+        if (*in >= end) return 0;
+        byte = *(*in)++;
+        *length += byte;
+    } while (byte == 255);
+    return 1;
+}
+
+long lz_decompress(const uint8_t* src, size_t size, uint8_t* dst, size_t capacity) {
+    const uint8_t* in = src;
+    const uint8_t* in_end = src + size;
+    uint8_t* out = dst;
+    uint8_t* out_end = dst + capacity;
+    
+    while (in < in_end) {
+        uint8_t token = *in++;
+        
+        size_t literal_length = token >> 4;
+        if (literal_length == 15 && !read_length(&in, in_end, &literal_length)) return -1;
+        if ((size_t)(in_end - in) < literal_length ||
+            (size_t)(out_end - out) < literal_length) {
+            return -1;
+        }
+        memcpy(out, in, literal_length);
+        in += literal_length;
+        out += literal_length;
+        
+        // Literals-only last sequence
+        if (in == in_end) break;
+        
+        if (in_end - in < 2) return -1;
+        size_t offset = in[0] | ((size_t)in[1] << 8);
+        in += 2;
+        
+        size_t match_length = token & 15;
+        if (match_length == 15 && !read_length(&in, in_end, &match_length)) return -1;
+        match_length += LZ_MIN_MATCH;
+        
+        if (offset == 0 || offset > (size_t)(out - dst) ||
+            (size_t)(out_end - out) < match_length) {
+            return -1;
+        }
+        
+        // Byte by byte, the match may overlap what it's copying
+        const uint8_t* match = out - offset;
+        for (size_t i = 0; i < match_length; i++) {
+            out[i] = match[i];
+        }
+        out += match_length;
+    }
+    
+    return (long)(out - dst);
+}
\ No newline at end of file
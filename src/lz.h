@@ -0,0 +1,17 @@
+#ifndef LZ_H
+#define LZ_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Small LZ77 block compressor in the style of LZ4: sequences of literals
+// followed by a back-reference of at least 4 bytes within the last 64 KiB.
+// Fast on both ends and good at the repetitive streams chunks produce.
+
+#define LZ_COMPRESS_BOUND(size) ((size) + (size) / 255 + 16)
+
+size_t lz_compress(const uint8_t* src, size_t size, uint8_t* dst, size_t capacity);
+// Decompressed size, or -1 if the input is malformed or doesn't fit
+long lz_decompress(const uint8_t* src, size_t size, uint8_t* dst, size_t capacity);
+
+#endif
\ No newline at end of file
@@ -50,7 +50,9 @@ int main(void) {
     printf("  1-9 - Select block type\n");
     printf("  ESC - Release mouse\n");
     printf("  F3 - Toggle debug info\n");
+    printf("  F4 - Toggle greedy meshing\n");
     printf("  F5 - Save world\n");
+    printf("  F6 - Toggle occlusion culling\n");
     printf("  F9 - Load world\n\n");
 
     glfwSetErrorCallback(error_callback);
@@ -1,198 +1,955 @@
 #include "mesh.h"
 #include "config.h"
+#include "arena.h"
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
-#define MAX_VERTICES (CHUNK_SIZE * CHUNK_HEIGHT * CHUNK_SIZE * 6 * 6 * 6)
-
-static void add_face(float* vertices, int* vertex_count, 
-                    float x, float y, float z,
-                    int face, const float* color) {
-    float brightness = 1.0f;
-    
-    // Adjust brightness based on face direction
-    if (face == 0) brightness = 1.0f;      // Top
-    else if (face == 1) brightness = 0.5f; // Bottom
-    else if (face == 2 || face == 3) brightness = 0.8f; // East/West
-    else brightness = 0.7f; // North/South
-    
-    float r = color[0] * brightness;
-    float g = color[1] * brightness;
-    float b = color[2] * brightness;
-    
-    float face_vertices[6][6]; // 6 vertices, each with 6 floats (x,y,z,r,g,b)
-    
-    switch (face) {
-        case 0: // Top
-            memcpy(face_vertices, (float[][6]){
-                {x, y+1, z,     r, g, b},
-                {x+1, y+1, z,   r, g, b},
-                {x+1, y+1, z+1, r, g, b},
-                {x, y+1, z,     r, g, b},
-                {x+1, y+1, z+1, r, g, b},
-                {x, y+1, z+1,   r, g, b}
-            }, sizeof(face_vertices));
-            break;
-        case 1: // Bottom
-            memcpy(face_vertices, (float[][6]){
-                {x, y, z,       r, g, b},
-                {x+1, y, z+1,   r, g, b},
-                {x+1, y, z,     r, g, b},
-                {x, y, z,       r, g, b},
-                {x, y, z+1,     r, g, b},
-                {x+1, y, z+1,   r, g, b}
-            }, sizeof(face_vertices));
-            break;
-        case 2: // East
-            memcpy(face_vertices, (float[][6]){
-                {x+1, y, z,     r, g, b},
-                {x+1, y+1, z,   r, g, b},
-                {x+1, y+1, z+1, r, g, b},
-                {x+1, y, z,     r, g, b},
-                {x+1, y+1, z+1, r, g, b},
-                {x+1, y, z+1,   r, g, b}
-            }, sizeof(face_vertices));
-            break;
-        case 3: // West
-            memcpy(face_vertices, (float[][6]){
-                {x, y, z,       r, g, b},
-                {x, y+1, z+1,   r, g, b},
-                {x, y+1, z,     r, g, b},
-                {x, y, z,       r, g, b},
-                {x, y, z+1,     r, g, b},
-                {x, y+1, z+1,   r, g, b}
-            }, sizeof(face_vertices));
-            break;
-        case 4: // South
-            memcpy(face_vertices, (float[][6]){
-                {x, y, z+1,     r, g, b},
-                {x+1, y+1, z+1, r, g, b},
-                {x+1, y, z+1,   r, g, b},
-                {x, y, z+1,     r, g, b},
-                {x, y+1, z+1,   r, g, b},
-                {x+1, y+1, z+1, r, g, b}
-            }, sizeof(face_vertices));
-            break;
-        case 5: // North
-            memcpy(face_vertices, (float[][6]){
-                {x, y, z,       r, g, b},
-                {x+1, y, z,     r, g, b},
-                {x+1, y+1, z,   r, g, b},
-                {x, y, z,       r, g, b},
-                {x+1, y+1, z,   r, g, b},
-                {x, y+1, z,     r, g, b}
-            }, sizeof(face_vertices));
-            break;
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#define CHUNK_VOLUME (CHUNK_SIZE * CHUNK_HEIGHT * CHUNK_SIZE)
+#define QUAD_INDEX_INITIAL 65536
+#define QUAD_BYTES (4 * sizeof(MeshVertex))
+
+// Arena sizes are in quads. Allocations are rounded up so a remesh of
+// about the same size fits the hole its old mesh left.
+#define ARENA_INITIAL_QUADS (1 << 18)
+#define ARENA_GRANULE 16
+
+// Staging ring for uploads, and how many of its copies can be in flight
+#define UPLOAD_RING_SIZE (4 * 1024 * 1024)
+#define UPLOAD_RING_FENCES 64
+
+// Columns are bitmasks over y, bit y lives in word y / 64
+#define COLUMN_WORDS (CHUNK_HEIGHT / 64)
+#define PADDED_SIZE (CHUNK_SIZE + 2)
+
+#if CHUNK_HEIGHT % 64 != 0
+#error "CHUNK_HEIGHT must be a multiple of 64 for column bitmasks"
+#endif
+
+#if CHUNK_SECTION_HEIGHT != 16
+#error "Column rows are classified 16 at a time, one section each"
+#endif
+
+// Occupancy of every column, with a one-block border of columns taken from
+// the neighboring chunks (padded coordinates are local + 1)
+typedef struct {
+    uint64_t solid[PADDED_SIZE][PADDED_SIZE][COLUMN_WORDS];
+    uint64_t opaque[PADDED_SIZE][PADDED_SIZE][COLUMN_WORDS];
+    // Decoded sections, only read where a solid bit is set
+    uint8_t blocks[CHUNK_SECTION_COUNT][CHUNK_SECTION_VOLUME];
+    // Faces of each column not covered by an opaque neighbor
+    uint64_t visible[CHUNK_SIZE][CHUNK_SIZE][6][COLUMN_WORDS];
+} MeshMasks;
+
+#define MASK_BLOCK(masks, x, y, z) \
+    ((masks)->blocks[(y) / CHUNK_SECTION_HEIGHT] \
+                    [SECTION_INDEX(x, (y) % CHUNK_SECTION_HEIGHT, z)])
+
+// Block types that let their neighbors show, air aside
+typedef struct {
+    bool opaque[256];
+    uint8_t see_through[BLOCK_COUNT];
+    int see_through_count;
+} BlockClasses;
+
+// Visible-face mask for greedy meshing, holds the block type or 0
+#define FACE_INDEX(face, x, y, z) \
+    ((((face) * CHUNK_SIZE + (x)) * CHUNK_HEIGHT + (y)) * CHUNK_SIZE + (z))
+
+// Corners of each face's quad as 0/1 offsets into the box, wound so that
+// the triangles (0, 1, 2) and (0, 2, 3) face outward
+static const uint8_t face_corners[6][4][3] = {
+    {{0, 1, 0}, {1, 1, 0}, {1, 1, 1}, {0, 1, 1}}, // Top
+    {{0, 0, 0}, {0, 0, 1}, {1, 0, 1}, {1, 0, 0}}, // Bottom
+    {{1, 0, 0}, {1, 1, 0}, {1, 1, 1}, {1, 0, 1}}, // East
+    {{0, 0, 0}, {0, 0, 1}, {0, 1, 1}, {0, 1, 0}}, // West
+    {{0, 0, 1}, {0, 1, 1}, {1, 1, 1}, {1, 0, 1}}, // South
+    {{0, 0, 0}, {1, 0, 0}, {1, 1, 0}, {0, 1, 0}}  // North
+};
+
+// Shared index buffer repeating 0,1,2, 0,2,3 for every quad
+static GLuint quad_index_buffer = 0;
+static int quad_index_capacity = 0;
+
+// The vertices of every mesh live in one buffer behind one VAO, each draw
+// picks its quads with a base vertex
+static GLuint arena_vao = 0;
+static GLuint arena_buffer = 0;
+static Arena arena;
+
+// Layout of the commands glMultiDrawElementsIndirect reads
+typedef struct {
+    GLuint count;
+    GLuint instance_count;
+    GLuint first_index;
+    GLint base_vertex;
+    GLuint base_instance;
+} DrawCommand;
+
+// Chunk origins come from an instanced attribute when multi-draw indirect
+// is available, each draw's base instance selecting its own. Otherwise
+// the attribute is set between draws of different chunks.
+static bool use_indirect = false;
+static GLuint origin_buffer = 0;
+static GLuint command_buffer = 0;
+
+// Per-batch scratch for either path
+static DrawCommand* batch_commands = NULL;
+static float* batch_origins = NULL;
+static GLsizei* batch_counts = NULL;
+static GLint* batch_base_vertices = NULL;
+static const void** batch_offsets = NULL;
+static int batch_capacity = 0;
+
+// A stretch of the ring the GPU may still be copying out of
+typedef struct {
+    GLsync fence;
+    size_t start;
+} RingCopy;
+
+// Persistently mapped staging buffer. Uploads are written at ring_head
+// and copied into the arena by the GPU; the copies in flight, oldest
+// first, hold the space between the oldest start and ring_head.
+static GLuint ring_buffer = 0;
+static uint8_t* ring_memory = NULL;
+static size_t ring_head = 0;
+static RingCopy ring_copies[UPLOAD_RING_FENCES];
+static int ring_first = 0;
+static int ring_count = 0;
+
+static MeshUploadStats upload_stats;
+
+// Emit the given face of the box at local (x, y, z) with extents (sx, sy, sz)
+static void add_face(MeshVertex* vertices, int* vertex_count,
+                    int x, int y, int z,
+                    int sx, int sy, int sz,
+                    int face, BlockType block) {
+    MeshVertex* out = &vertices[*vertex_count];
+    
+    for (int i = 0; i < 4; i++) {
+        const uint8_t* corner = face_corners[face][i];
+        out[i].position = MESH_PACK_POSITION(x + corner[0] * sx,
+                                             y + corner[1] * sy,
+                                             z + corner[2] * sz, face);
+        out[i].block = (uint32_t)block;
+    }
+    
+    *vertex_count += 4;
+}
+
+// Axis along each face's normal, followed by the two axes spanning it
+static const int face_axes[6][3] = {
+    {1, 0, 2}, {1, 0, 2},   // Top, Bottom
+    {0, 2, 1}, {0, 2, 1},   // East, West
+    {2, 0, 1}, {2, 0, 1}    // South, North
+};
+
+static const int axis_size[3] = {CHUNK_SIZE, CHUNK_HEIGHT, CHUNK_SIZE};
+
+// Merge coplanar faces of the same block type into maximal rectangles
+static void emit_greedy_faces(uint8_t* faces, int y_min, int y_max,
+                              MeshVertex* vertices, int* vertex_count) {
+    for (int face = 0; face < 6; face++) {
+        int d = face_axes[face][0];
+        int u = face_axes[face][1];
+        int v = face_axes[face][2];
+        int u_size = axis_size[u];
+        int v_size = axis_size[v];
+        
+        for (int s = 0; s < axis_size[d]; s++) {
+            if (d == 1 && (s < y_min || s > y_max)) continue;
+            
+            for (int j = 0; j < v_size; j++) {
+                if (v == 1 && (j < y_min || j > y_max)) continue;
+                
+                for (int i = 0; i < u_size; ) {
+                    int pos[3];
+                    pos[d] = s;
+                    pos[u] = i;
+                    pos[v] = j;
+                    
+                    uint8_t type = faces[FACE_INDEX(face, pos[0], pos[1], pos[2])];
+                    if (!type) {
+                        i++;
+                        continue;
+                    }
+                    
+                    // Grow along u, then along v while whole rows match
+                    int w = 1;
+                    for (; i + w < u_size; w++) {
+                        int p[3] = {pos[0], pos[1], pos[2]};
+                        p[u] = i + w;
+                        if (faces[FACE_INDEX(face, p[0], p[1], p[2])] != type) break;
+                    }
+                    
+                    int h = 1;
+                    for (; j + h < v_size; h++) {
+                        bool row_matches = true;
+                        for (int k = 0; k < w && row_matches; k++) {
+                            int p[3] = {pos[0], pos[1], pos[2]};
+                            p[u] = i + k;
+                            p[v] = j + h;
+                            row_matches = faces[FACE_INDEX(face, p[0], p[1], p[2])] == type;
+                        }
+                        if (!row_matches) break;
+                    }
+                    
+                    for (int dv = 0; dv < h; dv++) {
+                        for (int du = 0; du < w; du++) {
+                            int p[3] = {pos[0], pos[1], pos[2]};
+                            p[u] = i + du;
+                            p[v] = j + dv;
+                            faces[FACE_INDEX(face, p[0], p[1], p[2])] = 0;
+                        }
+                    }
+                    
+                    int size[3] = {1, 1, 1};
+                    size[u] = w;
+                    size[v] = h;
+                    
+                    add_face(vertices, vertex_count, pos[0], pos[1], pos[2],
+                             size[0], size[1], size[2], face, (BlockType)type);
+                    
+                    i += w;
+                }
+            }
+        }
+    }
+}
+
+static void classify_blocks(BlockClasses* classes) {
+    classes->see_through_count = 0;
+    for (int i = 0; i < 256; i++) {
+        classes->opaque[i] = !block_is_transparent((BlockType)i);
+        if (i != BLOCK_AIR && i < BLOCK_COUNT && !classes->opaque[i]) {
+            classes->see_through[classes->see_through_count++] = (uint8_t)i;
+        }
+    }
+}
+
+// Solid and opaque bits of 16 consecutive rows of a column
+static inline void classify_rows(const BlockClasses* classes, const uint8_t* rows,
+                                 uint32_t* solid, uint32_t* opaque) {
+#if defined(__SSE2__)
+    // A byte compare per see-through type, there are only a few
+    __m128i blocks = _mm_loadu_si128((const __m128i*)rows);
+    __m128i air = _mm_cmpeq_epi8(blocks, _mm_setzero_si128());
+    __m128i clear = air;
+    for (int i = 0; i < classes->see_through_count; i++) {
+        __m128i type = _mm_set1_epi8((char)classes->see_through[i]);
+        clear = _mm_or_si128(clear, _mm_cmpeq_epi8(blocks, type));
+    }
+    *solid = ~(uint32_t)_mm_movemask_epi8(air) & 0xFFFF;
+    *opaque = ~(uint32_t)_mm_movemask_epi8(clear) & 0xFFFF;
+#else
+    uint32_t solid_rows = 0;
+    uint32_t opaque_rows = 0;
+    for (int y = 0; y < 16; y++) {
+        solid_rows |= (uint32_t)(rows[y] != BLOCK_AIR) << y;
+        opaque_rows |= (uint32_t)classes->opaque[rows[y]] << y;
+    }
+    *solid = solid_rows;
+    *opaque = opaque_rows;
+#endif
+}
+
+// Put the 16 rows starting at y_base into the column at padded (px, pz)
+static inline void add_rows(MeshMasks* masks, const BlockClasses* classes,
+                            const uint8_t* rows, int px, int pz, int y_base) {
+    uint32_t solid_rows;
+    uint32_t opaque_rows;
+    classify_rows(classes, rows, &solid_rows, &opaque_rows);
+    
+    int word = y_base / 64;
+    int shift = y_base % 64;
+    masks->solid[px][pz][word] |= (uint64_t)solid_rows << shift;
+    masks->opaque[px][pz][word] |= (uint64_t)opaque_rows << shift;
+}
+
+// Fill the border column at padded (px, pz) from local (x, z) of a neighbor.
+// Only the given sections are read, faces elsewhere can't be covered.
+static void add_border_column(MeshMasks* masks, Chunk* neighbor, int x, int z,
+                              int px, int pz, uint16_t sections,
+                              const BlockClasses* classes) {
+    if (!neighbor || !neighbor->is_generated) return;
+    
+    for (int sy = 0; sy < CHUNK_SECTION_COUNT; sy++) {
+        if (!((sections >> sy) & 1) || chunk_section_is_empty(neighbor, sy)) continue;
+        
+        uint8_t rows[CHUNK_SECTION_HEIGHT];
+        chunk_read_column(neighbor, sy, x, z, rows);
+        add_rows(masks, classes, rows, px, pz, sy * CHUNK_SECTION_HEIGHT);
+    }
+}
+
+static void build_masks(Chunk* chunk, MeshMasks* masks) {
+    memset(masks->solid, 0, sizeof(masks->solid));
+    memset(masks->opaque, 0, sizeof(masks->opaque));
+    
+    // Air is transparent, so opaque blocks are always solid
+    BlockClasses classes;
+    classify_blocks(&classes);
+    
+    // Interior, each section decoded straight into the masks. Empty
+    // sections are never read, so they need no clearing.
+    uint16_t sections = 0;
+    for (int sy = 0; sy < CHUNK_SECTION_COUNT; sy++) {
+        if (chunk_section_is_empty(chunk, sy)) continue;
+        sections |= (uint16_t)(1 << sy);
+        
+        uint8_t* blocks = masks->blocks[sy];
+        chunk_read_section(chunk, sy, blocks);
+        int y_base = sy * CHUNK_SECTION_HEIGHT;
+        
+        // The blocks are at hand, so this is where stale graphs are redone
+        if ((chunk->graph_stale >> sy) & 1) chunk_update_graph(chunk, sy, blocks);
+        
+        for (int x = 0; x < CHUNK_SIZE; x++) {
+            for (int z = 0; z < CHUNK_SIZE; z++) {
+#if CHUNK_LAYOUT == CHUNK_LAYOUT_XZY
+                // Columns are contiguous already
+                const uint8_t* rows = &blocks[SECTION_INDEX(x, 0, z)];
+#else
+                uint8_t rows[CHUNK_SECTION_HEIGHT];
+                for (int y = 0; y < CHUNK_SECTION_HEIGHT; y++) {
+                    rows[y] = blocks[SECTION_INDEX(x, y, z)];
+                }
+#endif
+                add_rows(masks, &classes, rows, x + 1, z + 1, y_base);
+            }
+        }
+    }
+    
+    // One-block border from the four horizontal neighbors, next to
+    // sections that have faces at all
+    for (int i = 0; i < CHUNK_SIZE; i++) {
+        add_border_column(masks, chunk->west, CHUNK_SIZE - 1, i, 0, i + 1,
+                          sections, &classes);
+        add_border_column(masks, chunk->east, 0, i, CHUNK_SIZE + 1, i + 1,
+                          sections, &classes);
+        add_border_column(masks, chunk->north, i, CHUNK_SIZE - 1, i + 1, 0,
+                          sections, &classes);
+        add_border_column(masks, chunk->south, i, 0, i + 1, CHUNK_SIZE + 1,
+                          sections, &classes);
+    }
+}
+
+// Faces of the interior column at padded (px, pz) not covered by an opaque
+// neighbor, in face order. Returns how many there are.
+static int find_visible_faces(MeshMasks* masks, int px, int pz) {
+    const uint64_t* solid = masks->solid[px][pz];
+    const uint64_t* op = masks->opaque[px][pz];
+    uint64_t (*visible)[COLUMN_WORDS] = masks->visible[px - 1][pz - 1];
+    int count = 0;
+    
+    for (int w = 0; w < COLUMN_WORDS; w++) {
+        // Neighbors at y + 1 and y - 1 are the column itself, shifted
+        uint64_t above = (op[w] >> 1) | (w + 1 < COLUMN_WORDS ? op[w + 1] << 63 : 0);
+        uint64_t below = (op[w] << 1) | (w > 0 ? op[w - 1] >> 63 : 0);
+        
+        visible[0][w] = solid[w] & ~above;
+        visible[1][w] = solid[w] & ~below;
+        visible[2][w] = solid[w] & ~masks->opaque[px + 1][pz][w];
+        visible[3][w] = solid[w] & ~masks->opaque[px - 1][pz][w];
+        visible[4][w] = solid[w] & ~masks->opaque[px][pz + 1][w];
+        visible[5][w] = solid[w] & ~masks->opaque[px][pz - 1][w];
+        
+        for (int face = 0; face < 6; face++) {
+            count += __builtin_popcountll(visible[face][w]);
+        }
+    }
+    
+    return count;
+}
+
+// Reorder quads so each section's are contiguous, recording the ranges
+// and vertical extents. Returns the reordered vertices, NULL if out of
+// memory.
+static MeshVertex* sort_quads_by_section(MeshVertex* vertices, int vertex_count,
+                                         MeshData* out) {
+    int quad_count = vertex_count / 4;
+    uint8_t* quad_section = (uint8_t*)malloc(quad_count);
+    MeshVertex* sorted = (MeshVertex*)malloc(vertex_count * sizeof(MeshVertex));
+    if (!quad_section || !sorted) {
+        free(quad_section);
+        free(sorted);
+        return NULL;
+    }
+    
+    for (int q = 0; q < quad_count; q++) {
+        const MeshVertex* quad = &vertices[q * 4];
+        int min_y = CHUNK_HEIGHT;
+        int max_y = 0;
+        for (int i = 0; i < 4; i++) {
+            int y = (int)MESH_POSITION_Y(quad[i].position);
+            if (y < min_y) min_y = y;
+            if (y > max_y) max_y = y;
+        }
+        
+        // A top face at the very top of the chunk sits at CHUNK_HEIGHT
+        int sy = min_y < CHUNK_HEIGHT ? min_y / CHUNK_SECTION_HEIGHT : CHUNK_SECTION_COUNT - 1;
+        quad_section[q] = (uint8_t)sy;
+        
+        MeshSection* section = &out->sections[sy];
+        if (section->quad_count++ == 0) {
+            section->min_y = min_y;
+            section->max_y = max_y;
+        } else {
+            if (min_y < section->min_y) section->min_y = min_y;
+            if (max_y > section->max_y) section->max_y = max_y;
+        }
     }
     
-    // Copy to vertex buffer
-    memcpy(&vertices[*vertex_count * 6], face_vertices, sizeof(face_vertices));
-    *vertex_count += 6;
+    int next = 0;
+    out->min_y = CHUNK_HEIGHT;
+    out->max_y = 0;
+    for (int sy = 0; sy < CHUNK_SECTION_COUNT; sy++) {
+        MeshSection* section = &out->sections[sy];
+        section->first_quad = next;
+        next += section->quad_count;
+        
+        if (section->quad_count > 0) {
+            if (section->min_y < out->min_y) out->min_y = section->min_y;
+            if (section->max_y > out->max_y) out->max_y = section->max_y;
+        }
+    }
+    
+    // Stable, so quads keep their generation order within a section
+    int fill[CHUNK_SECTION_COUNT];
+    for (int sy = 0; sy < CHUNK_SECTION_COUNT; sy++) {
+        fill[sy] = out->sections[sy].first_quad;
+    }
+    for (int q = 0; q < quad_count; q++) {
+        int dst = fill[quad_section[q]]++;
+        memcpy(&sorted[dst * 4], &vertices[q * 4], 4 * sizeof(MeshVertex));
+    }
+    
+    free(quad_section);
+    return sorted;
 }
 
-ChunkMesh* mesh_build(Chunk* chunk) {
-    if (!chunk || !chunk->is_generated) return NULL;
+// Build the CPU-side vertices of a chunk, no GL calls
+bool mesh_generate(Chunk* chunk, MeshMode mode, MeshData* out) {
+    out->vertices = NULL;
+    out->vertex_count = 0;
+    memset(out->sections, 0, sizeof(out->sections));
+    out->min_y = 0;
+    out->max_y = 0;
+    
+    if (!chunk || !chunk->is_generated) return false;
     
-    // Allocate temporary vertex buffer
-    float* vertices = (float*)malloc(MAX_VERTICES * sizeof(float));
-    if (!vertices) return NULL;
+    MeshMasks* masks = (MeshMasks*)malloc(sizeof(MeshMasks));
+    if (!masks) return false;
+    build_masks(chunk, masks);
+    
+    // Size the vertex buffer from the exact number of visible faces,
+    // greedy merging can only reduce it
+    int face_count = 0;
+    for (int x = 0; x < CHUNK_SIZE; x++) {
+        for (int z = 0; z < CHUNK_SIZE; z++) {
+            face_count += find_visible_faces(masks, x + 1, z + 1);
+        }
+    }
+    
+    if (face_count == 0) {
+        free(masks);
+        return true;
+    }
+    
+    MeshVertex* vertices = (MeshVertex*)malloc(face_count * 4 * sizeof(MeshVertex));
+    if (!vertices) {
+        free(masks);
+        return false;
+    }
     
     int vertex_count = 0;
     
-    // Iterate through all blocks
+    // Greedy mode collects visible faces first and merges them afterwards
+    uint8_t* faces = NULL;
+    int y_min = CHUNK_HEIGHT;
+    int y_max = -1;
+    if (mode == MESH_MODE_GREEDY) {
+        faces = (uint8_t*)calloc(6 * CHUNK_VOLUME, 1);
+        if (!faces) {
+            free(vertices);
+            free(masks);
+            return false;
+        }
+    }
+    
     for (int x = 0; x < CHUNK_SIZE; x++) {
-        for (int y = 0; y < CHUNK_HEIGHT; y++) {
-            for (int z = 0; z < CHUNK_SIZE; z++) {
-                BlockType block = chunk_get_block(chunk, x, y, z);
-                
-                if (block == BLOCK_AIR) continue;
+        for (int z = 0; z < CHUNK_SIZE; z++) {
+            for (int face = 0; face < 6; face++) {
+                const uint64_t* visible = masks->visible[x][z][face];
                 
-                const BlockInfo* info = block_get_info(block);
-                
-                // World position
-                float wx = (float)(chunk->x * CHUNK_SIZE + x);
-                float wy = (float)y;
-                float wz = (float)(chunk->z * CHUNK_SIZE + z);
-                
-                // Check each face
-                int directions[][3] = {
-                    {0, 1, 0},   // Top
-                    {0, -1, 0},  // Bottom
-                    {1, 0, 0},   // East
-                    {-1, 0, 0},  // West
-                    {0, 0, 1},   // South
-                    {0, 0, -1}   // North
-                };
-                
-                for (int face = 0; face < 6; face++) {
-                    int nx = x + directions[face][0];
-                    int ny = y + directions[face][1];
-                    int nz = z + directions[face][2];
-                    
-                    BlockType neighbor = chunk_get_neighbor_block(chunk, nx, ny, nz);
+                for (int w = 0; w < COLUMN_WORDS; w++) {
+                    uint64_t bits = visible[w];
                     
-                    // Render face if neighbor is air or transparent
-                    if (neighbor == BLOCK_AIR || block_is_transparent(neighbor)) {
-                        add_face(vertices, &vertex_count, wx, wy, wz, face, info->color);
+                    while (bits) {
+                        int y = w * 64 + __builtin_ctzll(bits);
+                        bits &= bits - 1;
+                        
+                        uint8_t block = MASK_BLOCK(masks, x, y, z);
+                        
+                        if (faces) {
+                            faces[FACE_INDEX(face, x, y, z)] = block;
+                            if (y < y_min) y_min = y;
+                            if (y > y_max) y_max = y;
+                        } else {
+                            add_face(vertices, &vertex_count, x, y, z,
+                                     1, 1, 1, face, (BlockType)block);
+                        }
                     }
                 }
             }
         }
     }
     
-    // Create mesh if we have vertices
-    if (vertex_count == 0) {
-        free(vertices);
-        return NULL;
+    free(masks);
+    
+    if (faces) {
+        emit_greedy_faces(faces, y_min, y_max, vertices, &vertex_count);
+        free(faces);
     }
     
-    ChunkMesh* mesh = (ChunkMesh*)malloc(sizeof(ChunkMesh));
-    if (!mesh) {
-        free(vertices);
-        return NULL;
+    MeshVertex* sorted = sort_quads_by_section(vertices, vertex_count, out);
+    free(vertices);
+    if (!sorted) return false;
+    
+    out->vertices = sorted;
+    out->vertex_count = vertex_count;
+    return true;
+}
+
+void mesh_data_free(MeshData* data) {
+    if (data) {
+        free(data->vertices);
+        data->vertices = NULL;
+        data->vertex_count = 0;
     }
+}
+
+// Grow the shared quad index buffer to cover at least quad_count quads
+static bool reserve_quad_indices(int quad_count) {
+    if (quad_count <= quad_index_capacity) return true;
     
-    mesh->vertex_count = vertex_count;
+    int capacity = quad_index_capacity > 0 ? quad_index_capacity : QUAD_INDEX_INITIAL;
+    while (capacity < quad_count) capacity *= 2;
     
-    // Create VAO and VBO
-    glGenVertexArrays(1, &mesh->vao);
-    glGenBuffers(1, &mesh->vbo);
+    GLuint* indices = (GLuint*)malloc(capacity * 6 * sizeof(GLuint));
+    if (!indices) return false;
     
-    glBindVertexArray(mesh->vao);
-    glBindBuffer(GL_ARRAY_BUFFER, mesh->vbo);
-    glBufferData(GL_ARRAY_BUFFER, vertex_count * 6 * sizeof(float), 
-                 vertices, GL_STATIC_DRAW);
+    for (int q = 0; q < capacity; q++) {
+        GLuint base = (GLuint)q * 4;
+        indices[q * 6 + 0] = base;
+        indices[q * 6 + 1] = base + 1;
+        indices[q * 6 + 2] = base + 2;
+        indices[q * 6 + 3] = base;
+        indices[q * 6 + 4] = base + 2;
+        indices[q * 6 + 5] = base + 3;
+    }
+    
+    // Respecifying the same buffer object keeps existing VAOs valid
+    if (!quad_index_buffer) glGenBuffers(1, &quad_index_buffer);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, quad_index_buffer);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, capacity * 6 * sizeof(GLuint),
+                 indices, GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
     
-    // Position attribute
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
+    free(indices);
+    quad_index_capacity = capacity;
+    return true;
+}
+
+// Point the vertex attribute at the current arena buffer
+static void bind_arena_vertices(void) {
+    glBindVertexArray(arena_vao);
+    glBindBuffer(GL_ARRAY_BUFFER, arena_buffer);
+    
+    // Packed position/face and block id, unpacked in the vertex shader
+    glVertexAttribIPointer(0, 2, GL_UNSIGNED_INT, sizeof(MeshVertex), (void*)0);
     glEnableVertexAttribArray(0);
     
-    // Color attribute
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), 
-                         (void*)(3 * sizeof(float)));
-    glEnableVertexAttribArray(1);
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+// Move the meshes to a buffer at least size quads larger, copying on the GPU.
+// If the driver can't allocate it, the old buffer stays in use.
+static bool grow_arena(uint32_t size) {
+    uint32_t capacity = arena.capacity;
+    while (capacity < arena.capacity + size) capacity *= 2;
+    
+    // Only errors from the allocation below should count
+    while (glGetError() != GL_NO_ERROR) {}
+    
+    GLuint buffer;
+    glGenBuffers(1, &buffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+    glBufferData(GL_COPY_WRITE_BUFFER, (GLsizeiptr)capacity * QUAD_BYTES, NULL, GL_DYNAMIC_DRAW);
+    if (glGetError() == GL_OUT_OF_MEMORY) {
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        glDeleteBuffers(1, &buffer);
+        fprintf(stderr, "Out of video memory growing the mesh arena to %.1f MiB\n",
+                (double)capacity * QUAD_BYTES / (1024.0 * 1024.0));
+        return false;
+    }
+    glBindBuffer(GL_COPY_READ_BUFFER, arena_buffer);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0,
+                        (GLsizeiptr)arena.capacity * QUAD_BYTES);
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    
+    if (!arena_grow(&arena, capacity)) {
+        glDeleteBuffers(1, &buffer);
+        return false;
+    }
+    
+    glDeleteBuffers(1, &arena_buffer);
+    arena_buffer = buffer;
+    bind_arena_vertices();
+    
+    printf("Mesh arena grown to %.1f MiB\n", (double)capacity * QUAD_BYTES / (1024.0 * 1024.0));
+    return true;
+}
+
+// Map the staging ring, false if buffer storage isn't supported
+static bool create_upload_ring(void) {
+    if (!GLEW_VERSION_4_4 && !GLEW_ARB_buffer_storage) return false;
+    
+    GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    glGenBuffers(1, &ring_buffer);
+    glBindBuffer(GL_COPY_READ_BUFFER, ring_buffer);
+    glBufferStorage(GL_COPY_READ_BUFFER, UPLOAD_RING_SIZE, NULL, flags);
+    ring_memory = (uint8_t*)glMapBufferRange(GL_COPY_READ_BUFFER, 0, UPLOAD_RING_SIZE, flags);
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    
+    if (!ring_memory) {
+        glDeleteBuffers(1, &ring_buffer);
+        ring_buffer = 0;
+        return false;
+    }
+    
+    ring_head = 0;
+    ring_first = 0;
+    ring_count = 0;
+    return true;
+}
+
+// Forget the oldest copy once the GPU is done with it. With wait, block
+// until it is, counting a stall if it wasn't done already.
+static bool retire_ring_copy(bool wait) {
+    RingCopy* copy = &ring_copies[ring_first];
+    GLenum status = glClientWaitSync(copy->fence, 0, 0);
+    
+    if (status == GL_TIMEOUT_EXPIRED) {
+        if (!wait) return false;
+        
+        upload_stats.stalls++;
+        do {
+            status = glClientWaitSync(copy->fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+        } while (status == GL_TIMEOUT_EXPIRED);
+    }
+    
+    glDeleteSync(copy->fence);
+    ring_first = (ring_first + 1) % UPLOAD_RING_FENCES;
+    ring_count--;
+    return true;
+}
+
+// Claim size bytes of the ring, waiting on older copies if it's full.
+// Writes never catch up with the oldest copy exactly, so ring_head equal
+// to its start always means the ring is empty from there on.
+static size_t reserve_ring(size_t size) {
+    while (ring_count > 0 && retire_ring_copy(false)) {}
+    
+    for (;;) {
+        if (ring_count == 0) {
+            ring_head = 0;
+            break;
+        }
+        
+        size_t tail = ring_copies[ring_first].start;
+        if (ring_count < UPLOAD_RING_FENCES) {
+            if (ring_head >= tail) {
+                if (ring_head + size <= UPLOAD_RING_SIZE) break;
+                
+                // Skip the rest of the ring and start over at the front
+                if (size < tail) {
+                    ring_head = 0;
+                    break;
+                }
+            } else if (ring_head + size < tail) {
+                break;
+            }
+        }
+        
+        retire_ring_copy(true);
+    }
+    
+    size_t offset = ring_head;
+    ring_head += size;
+    return offset;
+}
+
+// Stage the vertices in the ring and have the GPU copy them into the arena
+static void upload_through_ring(const MeshData* data, uint32_t arena_offset) {
+    size_t size = data->vertex_count * sizeof(MeshVertex);
+    size_t offset = reserve_ring(size);
+    memcpy(ring_memory + offset, data->vertices, size);
+    
+    glBindBuffer(GL_COPY_READ_BUFFER, ring_buffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, arena_buffer);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, (GLintptr)offset,
+                        (GLintptr)arena_offset * QUAD_BYTES, (GLsizeiptr)size);
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    
+    int slot = (ring_first + ring_count) % UPLOAD_RING_FENCES;
+    ring_copies[slot].fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    ring_copies[slot].start = offset;
+    ring_count++;
+}
+
+bool mesh_init(void) {
+    if (!reserve_quad_indices(QUAD_INDEX_INITIAL)) return false;
+    if (!arena_init(&arena, ARENA_INITIAL_QUADS)) return false;
+    
+    glGenVertexArrays(1, &arena_vao);
+    glGenBuffers(1, &arena_buffer);
+    glGenBuffers(1, &origin_buffer);
+    
+    glBindBuffer(GL_ARRAY_BUFFER, arena_buffer);
+    glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)ARENA_INITIAL_QUADS * QUAD_BYTES, NULL,
+                 GL_DYNAMIC_DRAW);
+    bind_arena_vertices();
+    
+    use_indirect = GLEW_VERSION_4_3 || (GLEW_ARB_multi_draw_indirect && GLEW_ARB_base_instance);
+    
+    glBindVertexArray(arena_vao);
+    
+    // The element binding is VAO state
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, quad_index_buffer);
+    
+    if (use_indirect) {
+        glGenBuffers(1, &command_buffer);
+        glBindBuffer(GL_ARRAY_BUFFER, origin_buffer);
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+        glVertexAttribDivisor(1, 1);
+        glEnableVertexAttribArray(1);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
     
     glBindVertexArray(0);
     
-    free(vertices);
+    memset(&upload_stats, 0, sizeof(upload_stats));
+    upload_stats.persistent = create_upload_ring();
+    
+    printf("Mesh arena: %.1f MiB, drawn with %s, uploads through %s\n",
+           (double)ARENA_INITIAL_QUADS * QUAD_BYTES / (1024.0 * 1024.0),
+           use_indirect ? "glMultiDrawElementsIndirect" : "glMultiDrawElementsBaseVertex",
+           upload_stats.persistent ? "a persistent mapped ring" : "glBufferSubData");
+    return true;
+}
+
+void mesh_shutdown(void) {
+    if (quad_index_buffer) {
+        glDeleteBuffers(1, &quad_index_buffer);
+        quad_index_buffer = 0;
+        quad_index_capacity = 0;
+    }
+    
+    if (ring_buffer) {
+        while (ring_count > 0) retire_ring_copy(true);
+        glBindBuffer(GL_COPY_READ_BUFFER, ring_buffer);
+        glUnmapBuffer(GL_COPY_READ_BUFFER);
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+        glDeleteBuffers(1, &ring_buffer);
+        ring_buffer = 0;
+        ring_memory = NULL;
+    }
+    
+    if (arena_vao) {
+        glDeleteVertexArrays(1, &arena_vao);
+        glDeleteBuffers(1, &arena_buffer);
+        glDeleteBuffers(1, &origin_buffer);
+        if (command_buffer) glDeleteBuffers(1, &command_buffer);
+        arena_vao = 0;
+        arena_buffer = 0;
+        origin_buffer = 0;
+        command_buffer = 0;
+        arena_destroy(&arena);
+    }
+    
+    free(batch_commands);
+    free(batch_origins);
+    free(batch_counts);
+    free(batch_base_vertices);
+    free(batch_offsets);
+    batch_commands = NULL;
+    batch_origins = NULL;
+    batch_counts = NULL;
+    batch_base_vertices = NULL;
+    batch_offsets = NULL;
+    batch_capacity = 0;
+}
+
+// Copy the vertices into a free range of the arena, NULL if it has no room
+// and can't grow
+ChunkMesh* mesh_upload(const MeshData* data) {
+    if (!data || data->vertex_count == 0) return NULL;
+    
+    int quad_count = data->vertex_count / 4;
+    if (!reserve_quad_indices(quad_count)) return NULL;
+    
+    ChunkMesh* mesh = (ChunkMesh*)malloc(sizeof(ChunkMesh));
+    if (!mesh) return NULL;
+    
+    uint32_t size = (uint32_t)(quad_count + ARENA_GRANULE - 1) / ARENA_GRANULE * ARENA_GRANULE;
+    uint32_t offset;
+    if (!arena_alloc(&arena, size, &offset) &&
+        (!grow_arena(size) || !arena_alloc(&arena, size, &offset))) {
+        free(mesh);
+        return NULL;
+    }
+    
+    mesh->first_quad = (int)offset;
+    mesh->quad_capacity = (int)size;
+    mesh->vertex_count = data->vertex_count;
+    memcpy(mesh->sections, data->sections, sizeof(mesh->sections));
+    mesh->min_y = data->min_y;
+    mesh->max_y = data->max_y;
+    
+    // Meshes too big for the ring go the slow way
+    size_t bytes = data->vertex_count * sizeof(MeshVertex);
+    if (ring_memory && bytes < UPLOAD_RING_SIZE) {
+        upload_through_ring(data, offset);
+    } else {
+        glBindBuffer(GL_ARRAY_BUFFER, arena_buffer);
+        glBufferSubData(GL_ARRAY_BUFFER, (GLintptr)offset * QUAD_BYTES, bytes, data->vertices);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+    
+    upload_stats.uploads++;
+    upload_stats.bytes += bytes;
+    return mesh;
+}
+
+ChunkMesh* mesh_build(Chunk* chunk, MeshMode mode) {
+    MeshData data;
+    if (!mesh_generate(chunk, mode, &data)) return NULL;
     
-    chunk->is_dirty = false;
+    ChunkMesh* mesh = mesh_upload(&data);
+    if (mesh || data.vertex_count == 0) {
+        chunk->is_dirty = false;
+    }
+    mesh_data_free(&data);
     
     return mesh;
 }
 
 void mesh_destroy(ChunkMesh* mesh) {
     if (mesh) {
-        glDeleteVertexArrays(1, &mesh->vao);
-        glDeleteBuffers(1, &mesh->vbo);
+        arena_free(&arena, (uint32_t)mesh->first_quad, (uint32_t)mesh->quad_capacity);
         free(mesh);
     }
 }
 
-void mesh_render(ChunkMesh* mesh) {
-    if (mesh && mesh->vertex_count > 0) {
-        glBindVertexArray(mesh->vao);
-        glDrawArrays(GL_TRIANGLES, 0, mesh->vertex_count);
-        glBindVertexArray(0);
+static bool reserve_batch(int count) {
+    if (count <= batch_capacity) return true;
+    
+    int capacity = batch_capacity > 0 ? batch_capacity : 256;
+    while (capacity < count) capacity *= 2;
+    
+    DrawCommand* commands = (DrawCommand*)malloc(capacity * sizeof(DrawCommand));
+    float* origins = (float*)malloc(capacity * 3 * sizeof(float));
+    GLsizei* counts = (GLsizei*)malloc(capacity * sizeof(GLsizei));
+    GLint* base_vertices = (GLint*)malloc(capacity * sizeof(GLint));
+    const void** offsets = (const void**)malloc(capacity * sizeof(void*));
+    if (!commands || !origins || !counts || !base_vertices || !offsets) {
+        free(commands);
+        free(origins);
+        free(counts);
+        free(base_vertices);
+        free((void*)offsets);
+        return false;
     }
+    
+    free(batch_commands);
+    free(batch_origins);
+    free(batch_counts);
+    free(batch_base_vertices);
+    free((void*)batch_offsets);
+    batch_commands = commands;
+    batch_origins = origins;
+    batch_counts = counts;
+    batch_base_vertices = base_vertices;
+    batch_offsets = offsets;
+    batch_capacity = capacity;
+    return true;
+}
+
+// Submit runs of quads, as few calls as the driver allows. Runs of the
+// same mesh should be adjacent, the fallback sets each origin once.
+void mesh_draw(const MeshDraw* draws, int count) {
+    if (!draws || count <= 0 || !reserve_batch(count)) return;
+    
+    glBindVertexArray(arena_vao);
+    
+    if (use_indirect) {
+        for (int i = 0; i < count; i++) {
+            const MeshDraw* draw = &draws[i];
+            DrawCommand* command = &batch_commands[i];
+            command->count = (GLuint)draw->quad_count * 6;
+            command->instance_count = 1;
+            command->first_index = 0;
+            command->base_vertex = (draw->mesh->first_quad + draw->first_quad) * 4;
+            command->base_instance = (GLuint)i;
+            memcpy(&batch_origins[i * 3], draw->origin, 3 * sizeof(float));
+        }
+        
+        // Respecified every batch, so the driver can hand out fresh storage
+        glBindBuffer(GL_ARRAY_BUFFER, origin_buffer);
+        glBufferData(GL_ARRAY_BUFFER, count * 3 * sizeof(float), batch_origins, GL_STREAM_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, command_buffer);
+        glBufferData(GL_DRAW_INDIRECT_BUFFER, count * sizeof(DrawCommand), batch_commands,
+                     GL_STREAM_DRAW);
+        
+        glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void*)0, count, 0);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    } else {
+        for (int first = 0; first < count; ) {
+            const MeshDraw* chunk_draw = &draws[first];
+            int runs = 0;
+            
+            while (first + runs < count && draws[first + runs].mesh == chunk_draw->mesh) {
+                const MeshDraw* draw = &draws[first + runs];
+                batch_counts[runs] = draw->quad_count * 6;
+                batch_base_vertices[runs] = (draw->mesh->first_quad + draw->first_quad) * 4;
+                batch_offsets[runs] = NULL;
+                runs++;
+            }
+            
+            glVertexAttrib3f(1, chunk_draw->origin[0], chunk_draw->origin[1],
+                             chunk_draw->origin[2]);
+            glMultiDrawElementsBaseVertex(GL_TRIANGLES, batch_counts, GL_UNSIGNED_INT,
+                                          batch_offsets, runs, batch_base_vertices);
+            first += runs;
+        }
+    }
+    
+    glBindVertexArray(0);
+}
+
+void mesh_get_upload_stats(MeshUploadStats* stats) {
+    *stats = upload_stats;
+}
+
+void mesh_get_arena_stats(ArenaStats* stats) {
+    arena_get_stats(&arena, stats);
 }
\ No newline at end of file
@@ -3,15 +3,80 @@
 
 #include <GL/glew.h>
 #include "chunk.h"
+#include "arena.h"
 
+typedef enum {
+    MESH_MODE_NAIVE,    // One quad per visible block face
+    MESH_MODE_GREEDY    // Coplanar same-type faces merged into rectangles
+} MeshMode;
+
+// Chunk-local position (x and z 0..16, y 0..256) and face id packed into
+// one word, the block id in the other. Color and brightness are looked up
+// in the vertex shader. All chunks share one vertex buffer, so the chunk
+// offset is vertex attribute 1, set per draw.
+#define MESH_PACK_POSITION(x, y, z, face) \
+    ((uint32_t)(x) | ((uint32_t)(y) << 5) | ((uint32_t)(z) << 14) | ((uint32_t)(face) << 19))
+#define MESH_POSITION_Y(position) (((position) >> 5) & 0x1FF)
+
+typedef struct {
+    uint32_t position;
+    uint32_t block;
+} MeshVertex;
+
+// Contiguous quads of one 16-block section. A quad belongs to the section
+// of its lowest vertex; merged side faces can reach higher, so each range
+// has its own vertical extent.
 typedef struct {
-    GLuint vao;
-    GLuint vbo;
+    int first_quad;
+    int quad_count;
+    int min_y, max_y;
+} MeshSection;
+
+// CPU-side vertices of a chunk, four per quad, ordered by section
+typedef struct MeshData {
+    MeshVertex* vertices;
     int vertex_count;
+    MeshSection sections[CHUNK_SECTION_COUNT];
+    int min_y, max_y;               // Vertical extent of all quads
+} MeshData;
+
+// A range of the shared vertex arena. Quads are drawn through a shared
+// 0,1,2, 0,2,3 index buffer.
+typedef struct {
+    int first_quad;
+    int quad_capacity;
+    int vertex_count;
+    MeshSection sections[CHUNK_SECTION_COUNT];
+    int min_y, max_y;
 } ChunkMesh;
 
-ChunkMesh* mesh_build(Chunk* chunk);
+// A run of a mesh's quads and the world position of its chunk
+typedef struct MeshDraw {
+    const ChunkMesh* mesh;
+    int first_quad;         // Within the mesh
+    int quad_count;
+    float origin[3];
+} MeshDraw;
+
+// Totals since mesh_init. Uploads go through a persistent mapped ring
+// when buffer storage is supported; a stall is an upload that had to wait
+// for the GPU to finish copying out of the ring.
+typedef struct {
+    int uploads;
+    uint64_t bytes;
+    int stalls;
+    bool persistent;
+} MeshUploadStats;
+
+bool mesh_init(void);
+void mesh_shutdown(void);
+bool mesh_generate(Chunk* chunk, MeshMode mode, MeshData* out);
+void mesh_data_free(MeshData* data);
+ChunkMesh* mesh_upload(const MeshData* data);
+ChunkMesh* mesh_build(Chunk* chunk, MeshMode mode);
 void mesh_destroy(ChunkMesh* mesh);
-void mesh_render(ChunkMesh* mesh);
+void mesh_draw(const MeshDraw* draws, int count);
+void mesh_get_arena_stats(ArenaStats* stats);
+void mesh_get_upload_stats(MeshUploadStats* stats);
 
 #endif
\ No newline at end of file
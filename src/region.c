@@ -0,0 +1,584 @@
+#include "region.h"
+#include "crc32c.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <errno.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <direct.h>
+#include <io.h>
+#define make_directory(path) _mkdir(path)
+#define file_descriptor(file) _fileno(file)
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define make_directory(path) mkdir(path, 0755)
+#define file_descriptor(file) fileno(file)
+#endif
+
+#define REGION_HEADER_SIZE \
+    ((uint32_t)(sizeof(RegionHeader) + sizeof(((RegionFile*)0)->slots)))
+
+// Floor division, so chunk -1 lands in region -1
+static int region_coord(int chunk_coord) {
+    return chunk_coord >= 0 ? chunk_coord / REGION_SIZE
+                            : -((-chunk_coord - 1) / REGION_SIZE) - 1;
+}
+
+static int region_index(int chunk_x, int chunk_z) {
+    return (chunk_x & (REGION_SIZE - 1)) + (chunk_z & (REGION_SIZE - 1)) * REGION_SIZE;
+}
+
+static long entry_position(int index, int slot) {
+    return (long)sizeof(RegionHeader) +
+           (index * REGION_SLOTS + slot) * (long)sizeof(RegionEntry);
+}
+
+static uint32_t entry_checksum(const RegionEntry* entry) {
+    return crc32c(entry, offsetof(RegionEntry, entry_checksum));
+}
+
+// Sequence numbers wrap, so compare them by difference
+static bool is_newer(const RegionEntry* a, const RegionEntry* b) {
+    return (int32_t)(a->sequence - b->sequence) > 0;
+}
+
+// The slot a chunk's record is found through, NULL if it has none
+static const RegionEntry* live_entry(const RegionFile* region, int index) {
+    int slot = region->live[index];
+    return slot >= 0 ? &region->slots[index][slot] : NULL;
+}
+
+// Push a file's written data through to the disk. Takes no stdio lock,
+// so it runs while other threads use the FILE.
+static bool sync_descriptor(int descriptor) {
+#ifdef _WIN32
+    return _commit(descriptor) == 0;
+#else
+    return fsync(descriptor) == 0;
+#endif
+}
+
+// Push a file's buffered writes through to the disk
+static bool sync_file(FILE* file) {
+    return fflush(file) == 0 && sync_descriptor(file_descriptor(file));
+}
+
+static void region_filename(RegionStore* store, int region_x, int region_z,
+                            char* out, size_t size) {
+    snprintf(out, size, "%s/r.%d.%d.dat", store->path, region_x, region_z);
+}
+
+static void unmap_region(RegionFile* region) {
+    if (!region->map) return;
+    
+#ifdef _WIN32
+    UnmapViewOfFile(region->map);
+#else
+    munmap((void*)region->map, region->map_size);
+#endif
+    region->map = NULL;
+    region->map_size = 0;
+}
+
+// Map the whole file read-only. Records written through the FILE show up
+// in the mapping once flushed; only growth past its end needs a remap.
+// Without a mapping, records are read with fread instead.
+static void map_region(RegionFile* region) {
+    unmap_region(region);
+    
+    if (fflush(region->file) != 0 || fseek(region->file, 0, SEEK_END) != 0) return;
+    long size = ftell(region->file);
+    if (size <= 0) return;
+    
+#ifdef _WIN32
+    HANDLE file = (HANDLE)_get_osfhandle(_fileno(region->file));
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (!mapping) return;
+    
+    // The view keeps the mapping alive
+    void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping);
+    if (!view) return;
+#else
+    void* view = mmap(NULL, (size_t)size, PROT_READ, MAP_SHARED, fileno(region->file), 0);
+    if (view == MAP_FAILED) return;
+#endif
+    
+    region->map = (const uint8_t*)view;
+    region->map_size = (size_t)size;
+}
+
+static void close_region(RegionFile* region) {
+    unmap_region(region);
+    fclose(region->file);
+    pthread_mutex_destroy(&region->io);
+    free(region);
+}
+
+// Close a region that's not at the end of the open list
+static void forget_region(RegionStore* store, RegionFile* region) {
+    RegionFile** link = &store->open;
+    while (*link != region) link = &(*link)->next;
+    *link = region->next;
+    store->open_count--;
+    close_region(region);
+}
+
+// Copy a record's bytes out of the file, from the mapping if it covers
+// them, else with fread. Checksums are up to the caller.
+static bool copy_record(RegionFile* region, const RegionEntry* entry, uint8_t* out) {
+    if (entry->offset == 0 || entry->length > CODEC_MAX_SIZE) return false;
+    
+    // Written since the file was mapped
+    size_t end = (size_t)entry->offset + entry->length;
+    if (end > region->map_size) {
+        pthread_mutex_lock(&region->io);
+        map_region(region);
+        pthread_mutex_unlock(&region->io);
+    }
+    
+    if (end <= region->map_size) {
+        memcpy(out, region->map + entry->offset, entry->length);
+        return true;
+    }
+    
+    pthread_mutex_lock(&region->io);
+    bool ok = fseek(region->file, entry->offset, SEEK_SET) == 0 &&
+              fread(out, 1, entry->length, region->file) == entry->length;
+    pthread_mutex_unlock(&region->io);
+    return ok;
+}
+
+static bool is_missing(RegionStore* store, int region_x, int region_z) {
+    for (int i = 0; i < store->missing_count; i++) {
+        if (store->missing[i].x == region_x && store->missing[i].z == region_z) return true;
+    }
+    return false;
+}
+
+static void remember_missing(RegionStore* store, int region_x, int region_z) {
+    int slot = store->missing_count;
+    if (slot == REGION_MISSING_CACHE) {
+        slot = store->missing_next;
+        store->missing_next = (store->missing_next + 1) % REGION_MISSING_CACHE;
+    } else {
+        store->missing_count++;
+    }
+    store->missing[slot] = (RegionCoord){region_x, region_z};
+}
+
+static void forget_missing(RegionStore* store, int region_x, int region_z) {
+    for (int i = 0; i < store->missing_count; i++) {
+        if (store->missing[i].x == region_x && store->missing[i].z == region_z) {
+            store->missing[i] = store->missing[--store->missing_count];
+            store->missing_next = 0;
+            return;
+        }
+    }
+}
+
+// Create each missing directory along the path
+static void make_directories(const char* path) {
+    char partial[sizeof(((RegionStore*)0)->path)];
+    size_t length = strlen(path);
+    
+    for (size_t i = 1; i <= length; i++) {
+        if (path[i] == '/' || path[i] == '\\' || path[i] == '\0') {
+            memcpy(partial, path, i);
+            partial[i] = '\0';
+            make_directory(partial);
+        }
+    }
+}
+
+// Find an open region, opening (and with create, making) its file if needed
+static RegionFile* open_region(RegionStore* store, int region_x, int region_z, bool create) {
+    RegionFile* prev = NULL;
+    for (RegionFile* region = store->open; region; prev = region, region = region->next) {
+        if (region->x == region_x && region->z == region_z) {
+            // Move to the front
+            if (prev) {
+                prev->next = region->next;
+                region->next = store->open;
+                store->open = region;
+            }
+            return region;
+        }
+    }
+    
+    // Most chunks around a new world have no save to load from
+    if (!create && is_missing(store, region_x, region_z)) return NULL;
+    
+    char filename[sizeof(store->path) + 32];
+    region_filename(store, region_x, region_z, filename, sizeof(filename));
+    
+    FILE* file = fopen(filename, "r+b");
+    if (!file) {
+        if (!create) {
+            if (errno == ENOENT) remember_missing(store, region_x, region_z);
+            return NULL;
+        }
+        file = fopen(filename, "w+b");
+        if (!file) {
+            fprintf(stderr, "Failed to create region file: %s\n", filename);
+            return NULL;
+        }
+        forget_missing(store, region_x, region_z);
+    }
+    
+    RegionFile* region = (RegionFile*)calloc(1, sizeof(RegionFile));
+    if (!region) {
+        fclose(file);
+        return NULL;
+    }
+    region->x = region_x;
+    region->z = region_z;
+    region->file = file;
+    pthread_mutex_init(&region->io, NULL);
+    region->end = REGION_HEADER_SIZE;
+    memset(region->live, -1, sizeof(region->live));
+    
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    RegionHeader header;
+    
+    if (size >= (long)REGION_HEADER_SIZE) {
+        fseek(file, 0, SEEK_SET);
+        if (fread(&header, sizeof(header), 1, file) != 1 ||
+            header.magic != REGION_MAGIC || header.version != REGION_VERSION ||
+            fread(region->slots, sizeof(region->slots), 1, file) != 1) {
+            // Leave it alone rather than overwrite what may be someone's world
+            fprintf(stderr, "Unsupported region file: %s\n", filename);
+            close_region(region);
+            return NULL;
+        }
+        
+        // Forget slots that are empty, torn or point outside the file, and
+        // use the newer of what's left; records themselves are checked as
+        // they're read
+        uint64_t live = 0;
+        for (int i = 0; i < REGION_CHUNKS; i++) {
+            for (int slot = 0; slot < REGION_SLOTS; slot++) {
+                RegionEntry* entry = &region->slots[i][slot];
+                uint64_t end = (uint64_t)entry->offset + entry->length;
+                if (entry->entry_checksum != entry_checksum(entry) ||
+                    entry->offset < REGION_HEADER_SIZE || end > (uint64_t)size) {
+                    memset(entry, 0, sizeof(*entry));
+                    continue;
+                }
+                if (end > region->end) region->end = (uint32_t)end;
+                
+                const RegionEntry* current = live_entry(region, i);
+                if (!current || is_newer(entry, current)) region->live[i] = (int8_t)slot;
+            }
+            
+            const RegionEntry* entry = live_entry(region, i);
+            if (entry) live += entry->length;
+        }
+        
+        uint64_t used = region->end - REGION_HEADER_SIZE;
+        region->garbage = used > live ? (uint32_t)(used - live) : 0;
+    } else if (size == 0 || create) {
+        // New file, or one that crashed before its table was complete
+        header.magic = REGION_MAGIC;
+        header.version = REGION_VERSION;
+        fseek(file, 0, SEEK_SET);
+        if (fwrite(&header, sizeof(header), 1, file) != 1 ||
+            fwrite(region->slots, sizeof(region->slots), 1, file) != 1) {
+            close_region(region);
+            return NULL;
+        }
+    } else {
+        close_region(region);
+        return NULL;
+    }
+    
+    map_region(region);
+    
+    region->next = store->open;
+    store->open = region;
+    store->open_count++;
+    
+    // Close the least recently used file past the limit. Files with saves
+    // in flight stay open, over the limit if they have to.
+    if (store->open_count > REGION_MAX_OPEN) {
+        RegionFile** last = NULL;
+        for (RegionFile** link = &region->next; *link; link = &(*link)->next) {
+            if ((*link)->writers == 0) last = link;
+        }
+        if (last) {
+            RegionFile* closed = *last;
+            *last = closed->next;
+            close_region(closed);
+            store->open_count--;
+        }
+    }
+    
+    return region;
+}
+
+RegionStore* region_store_open(const char* path) {
+    if (!path || strlen(path) >= sizeof(((RegionStore*)0)->path)) return NULL;
+    
+    RegionStore* store = (RegionStore*)malloc(sizeof(RegionStore));
+    if (!store) return NULL;
+    
+    strcpy(store->path, path);
+    store->open = NULL;
+    store->open_count = 0;
+    store->free_scratch = NULL;
+    store->missing_count = 0;
+    store->missing_next = 0;
+    pthread_mutex_init(&store->lock, NULL);
+    
+    make_directories(path);
+    
+    return store;
+}
+
+void region_store_close(RegionStore* store) {
+    if (!store) return;
+    
+    while (store->open) {
+        RegionFile* region = store->open;
+        store->open = region->next;
+        close_region(region);
+    }
+    
+    while (store->free_scratch) {
+        RegionScratch* scratch = store->free_scratch;
+        store->free_scratch = scratch->next_free;
+        codec_scratch_destroy(scratch->codec);
+        free(scratch);
+    }
+    
+    pthread_mutex_destroy(&store->lock);
+    free(store);
+}
+
+// A scratch set for the calling thread, reused from earlier calls. There
+// are only ever as many as calls that ran at once.
+static RegionScratch* take_scratch(RegionStore* store) {
+    pthread_mutex_lock(&store->lock);
+    RegionScratch* scratch = store->free_scratch;
+    if (scratch) store->free_scratch = scratch->next_free;
+    pthread_mutex_unlock(&store->lock);
+    if (scratch) return scratch;
+    
+    scratch = (RegionScratch*)malloc(sizeof(RegionScratch));
+    if (!scratch) return NULL;
+    scratch->codec = codec_scratch_create();
+    if (!scratch->codec) {
+        free(scratch);
+        return NULL;
+    }
+    return scratch;
+}
+
+static void give_back_scratch(RegionStore* store, RegionScratch* scratch) {
+    pthread_mutex_lock(&store->lock);
+    scratch->next_free = store->free_scratch;
+    store->free_scratch = scratch;
+    pthread_mutex_unlock(&store->lock);
+}
+
+// Load a chunk's blocks into a freshly reset chunk, false if the save
+// doesn't hold it. Records of edits are replayed on the chunk's terrain.
+bool region_read_chunk(RegionStore* store, Chunk* chunk, TerrainGenerator* terrain) {
+    if (!store || !chunk) return false;
+    
+    RegionScratch* scratch = take_scratch(store);
+    if (!scratch) return false;
+    
+    // Only finding the record and copying it out happen under the lock
+    pthread_mutex_lock(&store->lock);
+    RegionEntry entry = {0};
+    bool copied = false;
+    RegionFile* region = open_region(store, region_coord(chunk->x), region_coord(chunk->z), false);
+    const RegionEntry* live = region ? live_entry(region, region_index(chunk->x, chunk->z)) : NULL;
+    if (live) {
+        entry = *live;
+        copied = copy_record(region, &entry, scratch->record);
+    }
+    pthread_mutex_unlock(&store->lock);
+    
+    bool found = false;
+    if (copied && crc32c(scratch->record, entry.length) == entry.checksum) {
+        found = codec_decode_chunk(chunk, terrain, scratch->record, entry.length, scratch->codec);
+    } else if (entry.offset != 0) {
+        fprintf(stderr, "Damaged chunk record (%d, %d), regenerating\n", chunk->x, chunk->z);
+    }
+    
+    give_back_scratch(store, scratch);
+    return found;
+}
+
+// Rewrite a region with only its live records into a temporary file that
+// then replaces it, so a crash leaves either the old or the new file. The
+// region is closed either way and reopens on its next use. Records pass
+// through buffer on their way.
+static void compact_region(RegionStore* store, RegionFile* region, uint8_t* buffer) {
+    char path[sizeof(store->path) + 32];
+    char temp_path[sizeof(path) + 4];
+    region_filename(store, region->x, region->z, path, sizeof(path));
+    snprintf(temp_path, sizeof(temp_path), "%s.tmp", path);
+    
+    // Live records go in each chunk's first slot, keeping their sequence
+    RegionHeader header = {REGION_MAGIC, REGION_VERSION};
+    RegionEntry (*slots)[REGION_SLOTS] = calloc(REGION_CHUNKS, sizeof(*slots));
+    
+    FILE* file = slots ? fopen(temp_path, "wb") : NULL;
+    bool ok = file && fseek(file, REGION_HEADER_SIZE, SEEK_SET) == 0;
+    uint32_t end = REGION_HEADER_SIZE;
+    
+    for (int i = 0; i < REGION_CHUNKS && ok; i++) {
+        // Damaged records are left behind
+        const RegionEntry* entry = live_entry(region, i);
+        if (!entry || !copy_record(region, entry, buffer) ||
+            crc32c(buffer, entry->length) != entry->checksum) {
+            continue;
+        }
+        
+        RegionEntry* moved = &slots[i][0];
+        *moved = *entry;
+        moved->offset = end;
+        moved->entry_checksum = entry_checksum(moved);
+        end += moved->length;
+        ok = fwrite(buffer, 1, moved->length, file) == moved->length;
+    }
+    
+    ok = ok && fseek(file, 0, SEEK_SET) == 0 &&
+         fwrite(&header, sizeof(header), 1, file) == 1 &&
+         fwrite(slots, sizeof(*slots), REGION_CHUNKS, file) == REGION_CHUNKS;
+    free(slots);
+    
+    // The old file has to be closed before it can be replaced
+    forget_region(store, region);
+    
+    if (ok) {
+        region_commit_file(file, temp_path, path);
+    } else if (file) {
+        fclose(file);
+        remove(temp_path);
+    }
+}
+
+// Append one chunk's record, then point its unused slot at it. The
+// superseded record stays in place until the region is compacted. With a terrain
+// generator, only the chunk's edits are stored when they're few. Returns
+// the record size, 0 on failure.
+size_t region_write_chunk(RegionStore* store, Chunk* chunk, TerrainGenerator* terrain) {
+    if (!store || !chunk) return 0;
+    
+    RegionScratch* scratch = take_scratch(store);
+    if (!scratch) return 0;
+    
+    uint32_t length = (uint32_t)codec_encode_chunk(chunk, terrain, scratch->record,
+                                                   scratch->codec);
+    uint32_t checksum = crc32c(scratch->record, length);
+    int index = region_index(chunk->x, chunk->z);
+    
+    // Reserve the record's space. The region stays open while it's written.
+    pthread_mutex_lock(&store->lock);
+    RegionFile* region = open_region(store, region_coord(chunk->x), region_coord(chunk->z), true);
+    uint32_t offset = 0;
+    if (region) {
+        offset = region->end;
+        region->end += length;
+        region->writers++;
+    }
+    pthread_mutex_unlock(&store->lock);
+    
+    if (!region) {
+        give_back_scratch(store, scratch);
+        return 0;
+    }
+    
+    // The record is on disk before any slot points at it. Syncing can take
+    // a while, and loads and other saves carry on meanwhile.
+    pthread_mutex_lock(&region->io);
+    bool ok = fseek(region->file, offset, SEEK_SET) == 0 &&
+              fwrite(scratch->record, 1, length, region->file) == length &&
+              fflush(region->file) == 0;
+    int descriptor = ok ? file_descriptor(region->file) : -1;
+    pthread_mutex_unlock(&region->io);
+    ok = ok && sync_descriptor(descriptor);
+    
+    pthread_mutex_lock(&store->lock);
+    region->writers--;
+    
+    if (ok) {
+        // Another save of the chunk may have been published meanwhile
+        const RegionEntry* current = live_entry(region, index);
+        int slot = current ? (region->live[index] + 1) % REGION_SLOTS : 0;
+        
+        RegionEntry entry;
+        entry.offset = offset;
+        entry.length = length;
+        entry.checksum = checksum;
+        entry.sequence = current ? current->sequence + 1 : 1;
+        entry.entry_checksum = entry_checksum(&entry);
+        
+        // A crash while the slot is written leaves it failing its checksum,
+        // and the other slot still holds the previous record
+        pthread_mutex_lock(&region->io);
+        ok = fseek(region->file, entry_position(index, slot), SEEK_SET) == 0 &&
+             fwrite(&entry, sizeof(entry), 1, region->file) == 1 &&
+             fflush(region->file) == 0;
+        pthread_mutex_unlock(&region->io);
+        
+        if (ok) {
+            if (current) region->garbage += current->length;
+            region->slots[index][slot] = entry;
+            region->live[index] = (int8_t)slot;
+        }
+    }
+    
+    // A record that never got an entry is as dead as a superseded one
+    if (!ok) region->garbage += length;
+    
+    // Compaction closes the file, so it waits for saves in flight
+    uint32_t live = region->end - REGION_HEADER_SIZE - region->garbage;
+    if (region->writers == 0 && region->garbage >= REGION_COMPACT_MIN &&
+        region->garbage > live) {
+        compact_region(store, region, scratch->record);
+    }
+    
+    pthread_mutex_unlock(&store->lock);
+    give_back_scratch(store, scratch);
+    return ok ? length : 0;
+}
+
+void region_store_flush(RegionStore* store) {
+    if (!store) return;
+    
+    pthread_mutex_lock(&store->lock);
+    for (RegionFile* region = store->open; region; region = region->next) {
+        pthread_mutex_lock(&region->io);
+        fflush(region->file);
+        pthread_mutex_unlock(&region->io);
+    }
+    pthread_mutex_unlock(&store->lock);
+}
+
+// Finish a file written at temp_path by moving it over path. Its data is
+// on disk before the rename, so a crash leaves the old or the new file,
+// never a mix. Closes the file either way.
+bool region_commit_file(FILE* file, const char* temp_path, const char* path) {
+    bool ok = sync_file(file);
+    ok = (fclose(file) == 0) && ok;
+    
+#ifdef _WIN32
+    ok = ok && MoveFileExA(temp_path, path,
+                           MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH);
+#else
+    ok = ok && rename(temp_path, path) == 0;
+#endif
+    
+    if (!ok) remove(temp_path);
+    return ok;
+}
\ No newline at end of file
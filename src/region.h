@@ -0,0 +1,102 @@
+#ifndef REGION_H
+#define REGION_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include "chunk.h"
+#include "codec.h"
+
+// Chunks are saved in region files of REGION_SIZE x REGION_SIZE chunks,
+// so each one can be read or rewritten on its own
+#define REGION_BITS 5
+#define REGION_SIZE (1 << REGION_BITS)
+#define REGION_CHUNKS (REGION_SIZE * REGION_SIZE)
+#define REGION_MAX_OPEN 16
+#define REGION_MISSING_CACHE 64
+
+#define REGION_MAGIC 0x47525856             // "VXRG"
+#define REGION_VERSION 2
+
+// Records are appended, never overwritten, so a crash mid-save leaves the
+// previous record intact. Once superseded records outweigh live ones and
+// take at least this many bytes, the file is rewritten without them.
+#define REGION_COMPACT_MIN (64 * 1024)
+
+// Start of every region file, followed by the entry table: REGION_SLOTS
+// entries per chunk
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+} RegionHeader;
+
+// Where a chunk's record lives in its region file. Each chunk has two
+// slots and a save rewrites the one not in use, so a torn table write only
+// damages that slot and the other still points at the previous record.
+#define REGION_SLOTS 2
+
+typedef struct {
+    uint32_t offset;
+    uint32_t length;
+    uint32_t checksum;                      // CRC-32C of the record
+    uint32_t sequence;                      // Of the chunk's valid slots, the higher is live
+    uint32_t entry_checksum;                // CRC-32C of the fields above
+} RegionEntry;
+
+typedef struct RegionFile RegionFile;
+
+struct RegionFile {
+    int x, z;
+    FILE* file;
+    pthread_mutex_t io;                     // Guards the FILE's position and buffer
+    int writers;                            // Saves in flight; the file stays open until they finish
+    uint32_t end;                           // First byte past the last record, reserved or written
+    uint32_t garbage;                       // Bytes of superseded records
+    const uint8_t* map;                     // Read-only view of the file, or NULL
+    size_t map_size;
+    RegionEntry slots[REGION_CHUNKS][REGION_SLOTS];    // Invalid slots zeroed
+    int8_t live[REGION_CHUNKS];             // Slot holding each chunk, -1 if absent
+    RegionFile* next;                       // Most recently used first
+};
+
+// Working memory of one read or write. Each call takes a set of its own,
+// so records are encoded and decoded outside the lock.
+typedef struct RegionScratch RegionScratch;
+
+struct RegionScratch {
+    uint8_t record[CODEC_MAX_SIZE];
+    CodecScratch* codec;
+    RegionScratch* next_free;
+};
+
+typedef struct {
+    int x, z;
+} RegionCoord;
+
+// All region files of one save directory. Workers load chunks through the
+// store while the main thread and save jobs write, so the lock guards the
+// files and lists below, but is only held to find a record and copy it
+// out, or to reserve space for one and publish its entry. Records are
+// written and synced outside it.
+typedef struct {
+    char path[256];
+    RegionFile* open;
+    int open_count;
+    RegionScratch* free_scratch;
+    // Regions known to have no file, so loading chunks there skips the
+    // fopen. Once full, entries are replaced round robin.
+    RegionCoord missing[REGION_MISSING_CACHE];
+    int missing_count;
+    int missing_next;
+    pthread_mutex_t lock;
+} RegionStore;
+
+RegionStore* region_store_open(const char* path);
+void region_store_close(RegionStore* store);
+bool region_read_chunk(RegionStore* store, Chunk* chunk, TerrainGenerator* terrain);
+size_t region_write_chunk(RegionStore* store, Chunk* chunk, TerrainGenerator* terrain);
+void region_store_flush(RegionStore* store);
+bool region_commit_file(FILE* file, const char* temp_path, const char* path);
+
+#endif
\ No newline at end of file
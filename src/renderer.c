@@ -5,6 +5,7 @@
 #include "config.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <math.h>
 
 Renderer* renderer_create(int width, int height) {
     Renderer* renderer = (Renderer*)malloc(sizeof(Renderer));
@@ -13,6 +14,25 @@ Renderer* renderer_create(int width, int height) {
     renderer->width = width;
     renderer->height = height;
     renderer->show_debug = false;
+    renderer->greedy_meshing = true;
+    renderer->occlusion_culling = true;
+    renderer->chunk_list = NULL;
+    renderer->chunk_boxes = NULL;
+    renderer->chunk_visible = NULL;
+    renderer->section_boxes = NULL;
+    renderer->section_visible = NULL;
+    renderer->draws = NULL;
+    renderer->visibility.queue = NULL;
+    renderer->visibility.capacity = 0;
+    renderer->visibility.frame = 0;
+    renderer->visibility.sections_reached = 0;
+    renderer->chunk_capacity = 0;
+    renderer->chunks_tested = 0;
+    renderer->chunks_culled = 0;
+    renderer->sections_tested = 0;
+    renderer->sections_culled = 0;
+    renderer->sections_occluded = 0;
+    renderer->draw_count = 0;
     
     // Load shaders
     renderer->shader_program = shader_load("shaders/vertex.glsl", "shaders/fragment.glsl");
@@ -27,12 +47,32 @@ Renderer* renderer_create(int width, int height) {
     renderer->u_view = glGetUniformLocation(renderer->shader_program, "view");
     renderer->u_model = glGetUniformLocation(renderer->shader_program, "model");
     
+    // Block colors are constant, the vertex shader indexes them by block id
+    float block_colors[BLOCK_COUNT * 3];
+    for (int i = 0; i < BLOCK_COUNT; i++) {
+        const BlockInfo* info = block_get_info((BlockType)i);
+        block_colors[i * 3 + 0] = info->color[0];
+        block_colors[i * 3 + 1] = info->color[1];
+        block_colors[i * 3 + 2] = info->color[2];
+    }
+    glUseProgram(renderer->shader_program);
+    shader_set_vec3_array(renderer->shader_program, "blockColors", BLOCK_COUNT, block_colors);
+    glUseProgram(0);
+    
     // Setup OpenGL state
     glEnable(GL_DEPTH_TEST);
     glEnable(GL_CULL_FACE);
     glCullFace(GL_BACK);
     glClearColor(0.5f, 0.7f, 1.0f, 1.0f);
     
+    if (!mesh_init()) {
+        fprintf(stderr, "Failed to create mesh buffers\n");
+        mesh_shutdown();
+        shader_delete(renderer->shader_program);
+        free(renderer);
+        return NULL;
+    }
+    
     printf("Renderer initialized\n");
     
     return renderer;
@@ -40,7 +80,15 @@ Renderer* renderer_create(int width, int height) {
 
 void renderer_destroy(Renderer* renderer) {
     if (renderer) {
+        mesh_shutdown();
         shader_delete(renderer->shader_program);
+        free(renderer->chunk_list);
+        free(renderer->chunk_boxes);
+        free(renderer->chunk_visible);
+        free(renderer->section_boxes);
+        free(renderer->section_visible);
+        free(renderer->draws);
+        free(renderer->visibility.queue);
         free(renderer);
     }
 }
@@ -62,6 +110,9 @@ void renderer_begin(Renderer* renderer, Player* player) {
     // Setup view matrix
     float eye[3], center[3], up[3];
     player_get_view_matrix(player, eye, center, up);
+    renderer->eye[0] = eye[0];
+    renderer->eye[1] = eye[1];
+    renderer->eye[2] = eye[2];
     
     float view[16];
     mat4_look_at(view, eye, center, up);
@@ -71,6 +122,11 @@ void renderer_begin(Renderer* renderer, Player* player) {
     float model[16];
     mat4_identity(model);
     shader_set_mat4(renderer->shader_program, "model", model);
+    
+    // Matrices are column-major, so this is projection * view
+    float clip[16];
+    mat4_multiply(clip, view, projection);
+    frustum_from_matrix(&renderer->frustum, clip);
 }
 
 void renderer_render_chunk(Renderer* renderer, Chunk* chunk) {
@@ -78,8 +134,187 @@ void renderer_render_chunk(Renderer* renderer, Chunk* chunk) {
     
     ChunkMesh* mesh = (ChunkMesh*)chunk->mesh;
     if (mesh) {
-        mesh_render(mesh);
+        MeshDraw draw = {mesh, 0, mesh->vertex_count / 4,
+                         {(float)(chunk->x * CHUNK_SIZE), 0.0f, (float)(chunk->z * CHUNK_SIZE)}};
+        mesh_draw(&draw, 1);
+    }
+}
+
+// Grow the culling arrays to hold count chunks and their sections
+static bool reserve_chunk_lists(Renderer* renderer, int count) {
+    if (count <= renderer->chunk_capacity) return true;
+    
+    int capacity = renderer->chunk_capacity > 0 ? renderer->chunk_capacity : 256;
+    while (capacity < count) capacity *= 2;
+    int section_capacity = capacity * CHUNK_SECTION_COUNT;
+    
+    // Whole batches, so the last one's spare lanes are initialized
+    int batches = (capacity + FRUSTUM_LANES - 1) / FRUSTUM_LANES;
+    int section_batches = (section_capacity + FRUSTUM_LANES - 1) / FRUSTUM_LANES;
+    
+    Chunk** list = (Chunk**)malloc(capacity * sizeof(Chunk*));
+    FrustumBoxes* boxes = (FrustumBoxes*)calloc(batches, sizeof(FrustumBoxes));
+    uint8_t* visible = (uint8_t*)malloc(capacity);
+    FrustumBoxes* section_boxes = (FrustumBoxes*)calloc(section_batches, sizeof(FrustumBoxes));
+    uint8_t* section_visible = (uint8_t*)malloc(section_capacity);
+    VisibilityNode* queue = (VisibilityNode*)malloc(section_capacity * sizeof(VisibilityNode));
+    MeshDraw* draws = (MeshDraw*)malloc(section_capacity * sizeof(MeshDraw));
+    if (!list || !boxes || !visible || !section_boxes || !section_visible || !queue ||
+        !draws) {
+        free(list);
+        free(boxes);
+        free(visible);
+        free(section_boxes);
+        free(section_visible);
+        free(queue);
+        free(draws);
+        return false;
+    }
+    
+    free(renderer->chunk_list);
+    free(renderer->chunk_boxes);
+    free(renderer->chunk_visible);
+    free(renderer->section_boxes);
+    free(renderer->section_visible);
+    free(renderer->draws);
+    free(renderer->visibility.queue);
+    renderer->chunk_list = list;
+    renderer->chunk_boxes = boxes;
+    renderer->chunk_visible = visible;
+    renderer->section_boxes = section_boxes;
+    renderer->section_visible = section_visible;
+    renderer->draws = draws;
+    renderer->visibility.queue = queue;
+    renderer->visibility.capacity = section_capacity;
+    renderer->chunk_capacity = capacity;
+    return true;
+}
+
+// Walk the section graphs out from the camera, false if the camera isn't
+// inside a loaded section and everything counts as reachable
+static bool traverse_visibility(Renderer* renderer, World* world) {
+    if (!renderer->occlusion_culling) return false;
+    
+    Chunk* start = world_find_chunk(world, (int)floorf(renderer->eye[0] / CHUNK_SIZE),
+                                    (int)floorf(renderer->eye[2] / CHUNK_SIZE));
+    int section_y = (int)floorf(renderer->eye[1] / CHUNK_SECTION_HEIGHT);
+    
+    return visibility_traverse(&renderer->visibility, start, section_y, &renderer->frustum);
+}
+
+// Whether the traversal reached a section range. Quads owned by a section
+// can reach into the sections above it, and faces on its floor are seen
+// from the section below, so any of those counts.
+static bool section_reached(const Renderer* renderer, const Chunk* chunk,
+                            const MeshSection* section, bool occlusion) {
+    if (!occlusion) return true;
+    if (chunk->visibility_frame != renderer->visibility.frame) return false;
+    
+    int low = (section->min_y > 0 ? section->min_y - 1 : 0) / CHUNK_SECTION_HEIGHT;
+    int high = (section->max_y < CHUNK_HEIGHT ? section->max_y : CHUNK_HEIGHT - 1) /
+               CHUNK_SECTION_HEIGHT;
+    uint32_t span = ((1u << (high + 1)) - 1) & ~((1u << low) - 1);
+    return (chunk->visible_sections & span) != 0;
+}
+
+// Draw the meshed chunks that the camera can see into and that intersect
+// the view frustum. Chunks are tested by the vertical extent of their
+// quads, then the sections of the visible ones one by one. Runs of
+// visible sections are one draw each, all submitted as one batch.
+void renderer_render_chunks(Renderer* renderer, World* world) {
+    if (!renderer || !world) return;
+    
+    Chunk** chunks = world->chunks;
+    int count = world->chunk_count;
+    if (!reserve_chunk_lists(renderer, count)) return;
+    
+    bool occlusion = traverse_visibility(renderer, world);
+    
+    int tested = 0;
+    for (int i = 0; i < count; i++) {
+        Chunk* chunk = chunks[i];
+        if (!chunk || !chunk->is_generated || !chunk->mesh) continue;
+        if (occlusion && chunk->visibility_frame != renderer->visibility.frame) continue;
+        
+        ChunkMesh* mesh = (ChunkMesh*)chunk->mesh;
+        float min[3] = {(float)(chunk->x * CHUNK_SIZE), (float)mesh->min_y,
+                        (float)(chunk->z * CHUNK_SIZE)};
+        float max[3] = {min[0] + CHUNK_SIZE, (float)mesh->max_y, min[2] + CHUNK_SIZE};
+        frustum_set_box(renderer->chunk_boxes, tested, min, max);
+        renderer->chunk_list[tested++] = chunk;
     }
+    
+    int visible = frustum_cull_boxes(&renderer->frustum, renderer->chunk_boxes, tested,
+                                     renderer->chunk_visible);
+    renderer->chunks_tested = tested;
+    renderer->chunks_culled = tested - visible;
+    
+    int sections = 0;
+    int occluded = 0;
+    for (int i = 0; i < tested; i++) {
+        if (!renderer->chunk_visible[i]) continue;
+        
+        Chunk* chunk = renderer->chunk_list[i];
+        ChunkMesh* mesh = (ChunkMesh*)chunk->mesh;
+        for (int sy = 0; sy < CHUNK_SECTION_COUNT; sy++) {
+            const MeshSection* section = &mesh->sections[sy];
+            if (section->quad_count == 0) continue;
+            if (!section_reached(renderer, chunk, section, occlusion)) {
+                occluded++;
+                continue;
+            }
+            
+            float min[3] = {(float)(chunk->x * CHUNK_SIZE), (float)section->min_y,
+                            (float)(chunk->z * CHUNK_SIZE)};
+            float max[3] = {min[0] + CHUNK_SIZE, (float)section->max_y, min[2] + CHUNK_SIZE};
+            frustum_set_box(renderer->section_boxes, sections++, min, max);
+        }
+    }
+    
+    int visible_sections = frustum_cull_boxes(&renderer->frustum, renderer->section_boxes,
+                                              sections, renderer->section_visible);
+    renderer->sections_tested = sections;
+    renderer->sections_culled = sections - visible_sections;
+    renderer->sections_occluded = occluded;
+    
+    // Same order as above, so section_visible is consumed in sequence
+    int next = 0;
+    int draw_count = 0;
+    for (int i = 0; i < tested; i++) {
+        if (!renderer->chunk_visible[i]) continue;
+        
+        Chunk* chunk = renderer->chunk_list[i];
+        ChunkMesh* mesh = (ChunkMesh*)chunk->mesh;
+        MeshDraw* run = &renderer->draws[draw_count];
+        run->mesh = mesh;
+        run->quad_count = 0;
+        run->origin[0] = (float)(chunk->x * CHUNK_SIZE);
+        run->origin[1] = 0.0f;
+        run->origin[2] = (float)(chunk->z * CHUNK_SIZE);
+        
+        for (int sy = 0; sy < CHUNK_SECTION_COUNT; sy++) {
+            const MeshSection* section = &mesh->sections[sy];
+            if (section->quad_count == 0) continue;
+            
+            // Unreached sections weren't tested, and don't advance next
+            if (section_reached(renderer, chunk, section, occlusion) &&
+                renderer->section_visible[next++]) {
+                // Sections are stored in order, so this extends the run
+                if (run->quad_count == 0) run->first_quad = section->first_quad;
+                run->quad_count = section->first_quad + section->quad_count - run->first_quad;
+            } else if (run->quad_count > 0) {
+                // Close the run, the next one starts out as a copy
+                renderer->draws[++draw_count] = *run;
+                run = &renderer->draws[draw_count];
+                run->quad_count = 0;
+            }
+        }
+        
+        if (run->quad_count > 0) draw_count++;
+    }
+    
+    renderer->draw_count = draw_count;
+    mesh_draw(renderer->draws, draw_count);
 }
 
 void renderer_end(Renderer* renderer) {
@@ -87,8 +322,10 @@ void renderer_end(Renderer* renderer) {
     glUseProgram(0);
 }
 
-void renderer_build_chunk_mesh(Renderer* renderer, Chunk* chunk) {
-    if (!renderer || !chunk) return;
+// Swap in vertices built off the main thread, false if the upload failed
+bool renderer_upload_chunk_mesh(Renderer* renderer, Chunk* chunk,
+                                const struct MeshData* data) {
+    if (!renderer || !chunk || !data) return false;
     
     // Destroy old mesh if exists
     if (chunk->mesh) {
@@ -96,8 +333,8 @@ void renderer_build_chunk_mesh(Renderer* renderer, Chunk* chunk) {
         chunk->mesh = NULL;
     }
     
-    // Build new mesh
-    chunk->mesh = mesh_build(chunk);
+    chunk->mesh = mesh_upload(data);
+    return chunk->mesh || data->vertex_count == 0;
 }
 
 void renderer_destroy_chunk_mesh(Chunk* chunk) {
@@ -124,9 +361,14 @@ void renderer_draw_debug_info(Renderer* renderer, Player* player,
     // For now, just print to console occasionally
     static int frame_counter = 0;
     if (frame_counter++ % 60 == 0) {
-        printf("FPS: %d | Pos: (%.1f, %.1f, %.1f) | Chunks: %d\n",
+        printf("FPS: %d | Pos: (%.1f, %.1f, %.1f) | Chunks: %d | Drawn: %d/%d, "
+               "sections %d/%d, %d occluded, %d draws\n",
                fps, player->position[0], player->position[1], 
-               player->position[2], chunk_count);
+               player->position[2], chunk_count,
+               renderer->chunks_tested - renderer->chunks_culled, renderer->chunks_tested,
+               renderer->sections_tested - renderer->sections_culled,
+               renderer->sections_tested, renderer->sections_occluded,
+               renderer->draw_count);
     }
 }
 
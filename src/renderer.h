@@ -3,7 +3,13 @@
 
 #include <stdbool.h>
 #include "chunk.h"
+#include "world.h"
 #include "player.h"
+#include "frustum.h"
+#include "visibility.h"
+
+struct MeshData;
+struct MeshDraw;
 
 typedef struct {
     unsigned int shader_program;
@@ -13,14 +19,34 @@ typedef struct {
     int u_view;
     int u_model;
     bool show_debug;
+    bool greedy_meshing;
+    bool occlusion_culling;
+    Frustum frustum;                // Of the camera set in renderer_begin
+    float eye[3];
+    VisibilityTraversal visibility; // Sections the camera could see into
+    Chunk** chunk_list;             // Meshed chunks being drawn
+    FrustumBoxes* chunk_boxes;      // and their bounds
+    uint8_t* chunk_visible;
+    FrustumBoxes* section_boxes;    // Non-empty sections of visible chunks
+    uint8_t* section_visible;
+    struct MeshDraw* draws;         // Runs of visible sections
+    int chunk_capacity;
+    int chunks_tested;              // By the last renderer_render_chunks
+    int chunks_culled;
+    int sections_tested;
+    int sections_culled;
+    int sections_occluded;
+    int draw_count;
 } Renderer;
 
 Renderer* renderer_create(int width, int height);
 void renderer_destroy(Renderer* renderer);
 void renderer_begin(Renderer* renderer, Player* player);
 void renderer_render_chunk(Renderer* renderer, Chunk* chunk);
+void renderer_render_chunks(Renderer* renderer, World* world);
 void renderer_end(Renderer* renderer);
-void renderer_build_chunk_mesh(Renderer* renderer, Chunk* chunk);
+bool renderer_upload_chunk_mesh(Renderer* renderer, Chunk* chunk,
+                                const struct MeshData* data);
 void renderer_destroy_chunk_mesh(Chunk* chunk);
 void renderer_draw_crosshair(Renderer* renderer);
 void renderer_draw_debug_info(Renderer* renderer, Player* player, 
@@ -108,6 +108,13 @@ void shader_set_vec3(GLuint program, const char* name, float x, float y, float z
     }
 }
 
+void shader_set_vec3_array(GLuint program, const char* name, int count, const float* values) {
+    GLint location = glGetUniformLocation(program, name);
+    if (location != -1) {
+        glUniform3fv(location, count, values);
+    }
+}
+
 void shader_set_float(GLuint program, const char* name, float value) {
     GLint location = glGetUniformLocation(program, name);
     if (location != -1) {
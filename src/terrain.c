@@ -1,22 +1,55 @@
 #include "terrain.h"
 #include "config.h"
 #include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
 #include <math.h>
+#include "../libs/noise/noise1234.h"
 
-static float simple_noise(float x, float z, int seed) {
-    int n = (int)(x * 57 + z * 131 + seed);
-    n = (n << 13) ^ n;
-    return (1.0f - ((n * (n * n * 15731 + 789221) + 1376312589) & 0x7fffffff) / 1073741824.0f);
+// Permutation table of the vendored noise1234.c
+extern unsigned char perm[];
+
+// Independent random streams, mixed into the position hash
+enum {
+    RANDOM_ORE_CHANCE = 1,
+    RANDOM_ORE_TYPE,
+    RANDOM_TREE,
+    RANDOM_NOISE_OFFSET
+};
+
+// Stateless per-block randomness: a splitmix64 finalizer over the seed,
+// world position and stream, so a chunk's contents never depend on which
+// chunks were generated before it or on which thread
+static uint64_t hash_position(int seed, int x, int y, int z, int stream) {
+    uint64_t h = (uint64_t)(uint32_t)seed * 0x9E3779B97F4A7C15ULL;
+    h ^= (uint64_t)(uint32_t)x * 0xBF58476D1CE4E5B9ULL;
+    h ^= (uint64_t)(uint32_t)y * 0x94D049BB133111EBULL;
+    h ^= (uint64_t)(uint32_t)z * 0xD6E8FEB86659FD93ULL;
+    h ^= (uint64_t)(uint32_t)stream * 0xA0761D6478BD642FULL;
+    
+    h ^= h >> 30;
+    h *= 0xBF58476D1CE4E5B9ULL;
+    h ^= h >> 27;
+    h *= 0x94D049BB133111EBULL;
+    h ^= h >> 31;
+    return h;
 }
 
-static float fbm(float x, float z, int seed) {
+static int random_percent(TerrainGenerator* gen, int x, int y, int z, int stream) {
+    return (int)(hash_position(gen->seed, x, y, z, stream) % 100);
+}
+
+// Fractal sum of Perlin octaves, normalized to noise2's range. The SIMD
+// kernel below performs the same operations in the same order per lane.
+static float fbm(TerrainGenerator* gen, float x, float z) {
     float total = 0.0f;
     float frequency = TERRAIN_SCALE;
     float amplitude = 1.0f;
     float max_value = 0.0f;
     
     for (int i = 0; i < TERRAIN_OCTAVES; i++) {
-        total += simple_noise(x * frequency, z * frequency, seed) * amplitude;
+        total += noise2(x * frequency + gen->octave_offset[i][0],
+                        z * frequency + gen->octave_offset[i][1]) * amplitude;
         max_value += amplitude;
         amplitude *= TERRAIN_PERSISTENCE;
         frequency *= TERRAIN_LACUNARITY;
@@ -25,8 +58,157 @@ static float fbm(float x, float z, int seed) {
     return total / max_value;
 }
 
-static int get_height(TerrainGenerator* gen, int x, int z) {
-    float noise_val = fbm((float)x, (float)z, gen->seed);
+#if defined(__AVX2__) || defined(__SSE2__)
+
+// Thin layer over the widest integer/float vectors available, so the
+// batched kernel is written once
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define NOISE_LANES 8
+typedef __m256 vfloat;
+typedef __m256i vint;
+#define vf_set1 _mm256_set1_ps
+#define vf_load _mm256_loadu_ps
+#define vf_store _mm256_storeu_ps
+#define vf_add _mm256_add_ps
+#define vf_sub _mm256_sub_ps
+#define vf_mul _mm256_mul_ps
+#define vf_div _mm256_div_ps
+#define vf_lt(a, b) _mm256_castps_si256(_mm256_cmp_ps(a, b, _CMP_LT_OQ))
+#define vf_from_int _mm256_cvtepi32_ps
+#define vf_to_int _mm256_cvttps_epi32
+#define vf_as_int _mm256_castps_si256
+#define vi_as_float _mm256_castsi256_ps
+#define vi_set1 _mm256_set1_epi32
+#define vi_load(p) _mm256_loadu_si256((const __m256i*)(p))
+#define vi_add _mm256_add_epi32
+#define vi_and _mm256_and_si256
+#define vi_andnot _mm256_andnot_si256
+#define vi_or _mm256_or_si256
+#define vi_xor _mm256_xor_si256
+#define vi_eq _mm256_cmpeq_epi32
+#define vi_shl _mm256_slli_epi32
+#define vi_gather(table, index) _mm256_i32gather_epi32(table, index, 4)
+#else
+#include <emmintrin.h>
+#define NOISE_LANES 4
+typedef __m128 vfloat;
+typedef __m128i vint;
+#define vf_set1 _mm_set1_ps
+#define vf_load _mm_loadu_ps
+#define vf_store _mm_storeu_ps
+#define vf_add _mm_add_ps
+#define vf_sub _mm_sub_ps
+#define vf_mul _mm_mul_ps
+#define vf_div _mm_div_ps
+#define vf_lt(a, b) _mm_castps_si128(_mm_cmplt_ps(a, b))
+#define vf_from_int _mm_cvtepi32_ps
+#define vf_to_int _mm_cvttps_epi32
+#define vf_as_int _mm_castps_si128
+#define vi_as_float _mm_castsi128_ps
+#define vi_set1 _mm_set1_epi32
+#define vi_load(p) _mm_loadu_si128((const __m128i*)(p))
+#define vi_add _mm_add_epi32
+#define vi_and _mm_and_si128
+#define vi_andnot _mm_andnot_si128
+#define vi_or _mm_or_si128
+#define vi_xor _mm_xor_si128
+#define vi_eq _mm_cmpeq_epi32
+#define vi_shl _mm_slli_epi32
+
+// SSE2 has no gather, go through memory
+static inline vint vi_gather(const int32_t* table, vint index) {
+    int32_t lanes[4];
+    _mm_storeu_si128((__m128i*)lanes, index);
+    return _mm_set_epi32(table[lanes[3]], table[lanes[2]], table[lanes[1]], table[lanes[0]]);
+}
+#endif
+
+static inline vint v_fastfloor(vfloat x) {
+    // noise1234's FASTFLOOR: truncate, then step down unless (int)x < x
+    vint t = vf_to_int(x);
+    vint keep = vf_lt(vf_from_int(t), x);
+    return vi_add(t, vi_andnot(keep, vi_set1(-1)));
+}
+
+static inline vfloat v_fade(vfloat t) {
+    vfloat t3 = vf_mul(vf_mul(t, t), t);
+    vfloat inner = vf_add(vf_mul(t, vf_sub(vf_mul(t, vf_set1(6.0f)), vf_set1(15.0f))),
+                          vf_set1(10.0f));
+    return vf_mul(t3, inner);
+}
+
+static inline vfloat v_lerp(vfloat t, vfloat a, vfloat b) {
+    return vf_add(a, vf_mul(t, vf_sub(b, a)));
+}
+
+static inline vfloat v_grad2(vint hash, vfloat x, vfloat y) {
+    vint low = vi_eq(vi_and(hash, vi_set1(4)), vi_set1(0));
+    vfloat u = vi_as_float(vi_or(vi_and(low, vf_as_int(x)), vi_andnot(low, vf_as_int(y))));
+    vfloat v = vi_as_float(vi_or(vi_and(low, vf_as_int(y)), vi_andnot(low, vf_as_int(x))));
+    
+    // Hash bits 0 and 1 flip the signs of u and 2v
+    u = vi_as_float(vi_xor(vf_as_int(u), vi_shl(vi_and(hash, vi_set1(1)), 31)));
+    v = vi_as_float(vi_xor(vf_as_int(vf_add(v, v)), vi_shl(vi_and(hash, vi_set1(2)), 30)));
+    return vf_add(u, v);
+}
+
+// noise2 for NOISE_LANES points at once
+static inline vfloat v_noise2(const int32_t* perm, vfloat x, vfloat y) {
+    vint ix0 = v_fastfloor(x);
+    vint iy0 = v_fastfloor(y);
+    vfloat fx0 = vf_sub(x, vf_from_int(ix0));
+    vfloat fy0 = vf_sub(y, vf_from_int(iy0));
+    vfloat fx1 = vf_sub(fx0, vf_set1(1.0f));
+    vfloat fy1 = vf_sub(fy0, vf_set1(1.0f));
+    vint ix1 = vi_and(vi_add(ix0, vi_set1(1)), vi_set1(0xff));
+    vint iy1 = vi_and(vi_add(iy0, vi_set1(1)), vi_set1(0xff));
+    ix0 = vi_and(ix0, vi_set1(0xff));
+    iy0 = vi_and(iy0, vi_set1(0xff));
+    
+    vfloat t = v_fade(fy0);
+    vfloat s = v_fade(fx0);
+    
+    vint py0 = vi_gather(perm, iy0);
+    vint py1 = vi_gather(perm, iy1);
+    
+    vfloat n0 = v_lerp(t, v_grad2(vi_gather(perm, vi_add(ix0, py0)), fx0, fy0),
+                          v_grad2(vi_gather(perm, vi_add(ix0, py1)), fx0, fy1));
+    vfloat n1 = v_lerp(t, v_grad2(vi_gather(perm, vi_add(ix1, py0)), fx1, fy0),
+                          v_grad2(vi_gather(perm, vi_add(ix1, py1)), fx1, fy1));
+    
+    return vf_mul(vf_set1(0.507f), v_lerp(s, n0, n1));
+}
+
+// fbm of NOISE_LANES consecutive columns starting at (x, z)
+static void fbm_lanes(TerrainGenerator* gen, int x, int z, float* out) {
+    int32_t columns[NOISE_LANES];
+    for (int i = 0; i < NOISE_LANES; i++) columns[i] = x + i;
+    
+    vfloat vx = vf_from_int(vi_load(columns));
+    vfloat vz = vf_set1((float)z);
+    vfloat total = vf_set1(0.0f);
+    float frequency = TERRAIN_SCALE;
+    float amplitude = 1.0f;
+    float max_value = 0.0f;
+    
+    for (int i = 0; i < TERRAIN_OCTAVES; i++) {
+        vfloat nx = vf_add(vf_mul(vx, vf_set1(frequency)), vf_set1(gen->octave_offset[i][0]));
+        vfloat nz = vf_add(vf_mul(vz, vf_set1(frequency)), vf_set1(gen->octave_offset[i][1]));
+        total = vf_add(total, vf_mul(v_noise2(gen->perm, nx, nz), vf_set1(amplitude)));
+        max_value += amplitude;
+        amplitude *= TERRAIN_PERSISTENCE;
+        frequency *= TERRAIN_LACUNARITY;
+    }
+    
+    vf_store(out, vf_div(total, vf_set1(max_value)));
+}
+
+#else
+#define NOISE_LANES 1
+#endif
+
+static int height_from_noise(float noise_val) {
     int height = TERRAIN_BASE + (int)(noise_val * TERRAIN_HEIGHT_MULTIPLIER);
     
     if (height < 1) height = 1;
@@ -35,8 +217,39 @@ static int get_height(TerrainGenerator* gen, int x, int z) {
     return height;
 }
 
-static BlockType get_ore_type(int y) {
-    int rand_val = rand() % 100;
+// Surface height of width x depth columns starting at world (origin_x,
+// origin_z), stored as heights[z * width + x]
+void terrain_get_heightmap(TerrainGenerator* gen, int origin_x, int origin_z,
+                           int width, int depth, int* heights) {
+    if (!gen || !heights) return;
+    
+    for (int z = 0; z < depth; z++) {
+        int* row = heights + z * width;
+        int x = 0;
+        
+#if NOISE_LANES > 1
+        while (x < width && width >= NOISE_LANES) {
+            // A ragged tail is redone as a full group overlapping the last
+            // one, lanes match the scalar path bit for bit anyway
+            if (x + NOISE_LANES > width) x = width - NOISE_LANES;
+            
+            float noise_vals[NOISE_LANES];
+            fbm_lanes(gen, origin_x + x, origin_z + z, noise_vals);
+            for (int i = 0; i < NOISE_LANES; i++) {
+                row[x + i] = height_from_noise(noise_vals[i]);
+            }
+            x += NOISE_LANES;
+        }
+#endif
+        
+        for (; x < width; x++) {
+            row[x] = height_from_noise(fbm(gen, (float)(origin_x + x), (float)(origin_z + z)));
+        }
+    }
+}
+
+static BlockType get_ore_type(TerrainGenerator* gen, int world_x, int y, int world_z) {
+    int rand_val = random_percent(gen, world_x, y, world_z, RANDOM_ORE_TYPE);
     
     if (y < 16) {
         if (rand_val < 30) return BLOCK_DIAMOND_ORE;
@@ -49,68 +262,98 @@ static BlockType get_ore_type(int y) {
     return BLOCK_COAL_ORE;
 }
 
-static void generate_column(TerrainGenerator* gen, Chunk* chunk, int x, int z, int height) {
-    chunk_set_block(chunk, x, 0, z, BLOCK_BEDROCK);
+// Leaves reach this far from a trunk, so trees rooted up to this many
+// columns outside the chunk still put blocks inside it
+#define TREE_RADIUS 2
+#define DECORATION_SIZE (CHUNK_SIZE + 2 * TREE_RADIUS)
+
+// Dense blocks of a whole chunk being generated, one SECTION_INDEX-ordered
+// array per section, handed to the chunk section by section at the end
+typedef uint8_t ChunkBlocks[CHUNK_SECTION_COUNT][CHUNK_SECTION_VOLUME];
+
+static inline uint8_t* block_at(ChunkBlocks blocks, int x, int y, int z) {
+    return &blocks[y / CHUNK_SECTION_HEIGHT][SECTION_INDEX(x, y % CHUNK_SECTION_HEIGHT, z)];
+}
+
+// Set blocks y_min..y_max-1 of a column, a memset per section when the
+// layout keeps columns contiguous
+static void fill_run(ChunkBlocks blocks, int x, int z, int y_min, int y_max, BlockType type) {
+    while (y_min < y_max) {
+        int end = (y_min / CHUNK_SECTION_HEIGHT + 1) * CHUNK_SECTION_HEIGHT;
+        if (end > y_max) end = y_max;
+        
+        uint8_t* run = block_at(blocks, x, y_min, z);
+        if (SECTION_STRIDE_Y == 1) {
+            memset(run, type, end - y_min);
+        } else {
+            for (int i = 0; i < end - y_min; i++) {
+                run[i * SECTION_STRIDE_Y] = (uint8_t)type;
+            }
+        }
+        y_min = end;
+    }
+}
+
+// Base pass: everything in a column up to its surface and sea level
+static void generate_column(TerrainGenerator* gen, Chunk* chunk, ChunkBlocks blocks,
+                            int x, int z, int height) {
+    int world_x = chunk->x * CHUNK_SIZE + x;
+    int world_z = chunk->z * CHUNK_SIZE + z;
+    
+    *block_at(blocks, x, 0, z) = BLOCK_BEDROCK;
     
     int stone_height = height - 4;
     if (stone_height < 1) stone_height = 1;
     
+    fill_run(blocks, x, z, 1, stone_height, BLOCK_STONE);
     for (int y = 1; y < stone_height; y++) {
-        if (rand() % 100 < 1) {
-            chunk_set_block(chunk, x, y, z, get_ore_type(y));
-        } else {
-            chunk_set_block(chunk, x, y, z, BLOCK_STONE);
+        if (random_percent(gen, world_x, y, world_z, RANDOM_ORE_CHANCE) < 1) {
+            *block_at(blocks, x, y, z) = get_ore_type(gen, world_x, y, world_z);
         }
     }
     
     int dirt_height = height - 1;
     if (dirt_height < stone_height) dirt_height = stone_height;
     
-    for (int y = stone_height; y < dirt_height; y++) {
-        chunk_set_block(chunk, x, y, z, BLOCK_DIRT);
-    }
+    fill_run(blocks, x, z, stone_height, dirt_height, BLOCK_DIRT);
     
     if (height >= SEA_LEVEL) {
-        chunk_set_block(chunk, x, height, z, BLOCK_GRASS);
-        
-        if (height > SEA_LEVEL + 30) {
-            chunk_set_block(chunk, x, height, z, BLOCK_SNOW);
-        }
-        
-        if (rand() % 100 < 2 && height < CHUNK_HEIGHT - 10) {
-            for (int dy = 1; dy < 6; dy++) {
-                chunk_set_block(chunk, x, height + dy, z, BLOCK_WOOD);
-            }
-            
-            for (int dx = -2; dx <= 2; dx++) {
-                for (int dz = -2; dz <= 2; dz++) {
-                    for (int dy = 4; dy <= 7; dy++) {
-                        if (x + dx >= 0 && x + dx < CHUNK_SIZE &&
-                            z + dz >= 0 && z + dz < CHUNK_SIZE &&
-                            height + dy < CHUNK_HEIGHT) {
-                            if (abs(dx) + abs(dz) <= 3) {
-                                if (chunk_get_block(chunk, x + dx, height + dy, z + dz) == BLOCK_AIR) {
-                                    chunk_set_block(chunk, x + dx, height + dy, z + dz, BLOCK_LEAVES);
-                                }
-                            }
-                        }
-                    }
-                }
-            }
-        }
+        *block_at(blocks, x, height, z) = (height > SEA_LEVEL + 30) ? BLOCK_SNOW : BLOCK_GRASS;
     } else {
         if (height > SEA_LEVEL - 3) {
-            for (int y = height - 2; y <= height; y++) {
-                if (y >= 0) {
-                    chunk_set_block(chunk, x, y, z, BLOCK_SAND);
-                }
-            }
+            fill_run(blocks, x, z, height - 2, height + 1, BLOCK_SAND);
         } else {
-            chunk_set_block(chunk, x, height, z, BLOCK_DIRT);
+            *block_at(blocks, x, height, z) = BLOCK_DIRT;
         }
         
-        for (int y = height + 1; y <= SEA_LEVEL; y++) {
-            chunk_set_block(chunk, x, y, z, BLOCK_WATER);
+        fill_run(blocks, x, z, height + 1, SEA_LEVEL + 1, BLOCK_WATER);
+    }
+}
+
+static bool has_tree(TerrainGenerator* gen, int world_x, int world_z, int height) {
+    return height >= SEA_LEVEL && height < CHUNK_HEIGHT - 10 &&
+           random_percent(gen, world_x, height, world_z, RANDOM_TREE) < 2;
+}
+
+// Decoration pass: the part of a tree rooted at chunk-local (x, z) that
+// falls inside this chunk. The root may lie in a neighboring chunk.
+static void place_tree(ChunkBlocks blocks, int x, int z, int height) {
+    if (x >= 0 && x < CHUNK_SIZE && z >= 0 && z < CHUNK_SIZE) {
+        fill_run(blocks, x, z, height + 1, height + 6, BLOCK_WOOD);
+    }
+    
+    for (int dx = -TREE_RADIUS; dx <= TREE_RADIUS; dx++) {
+        for (int dz = -TREE_RADIUS; dz <= TREE_RADIUS; dz++) {
+            if (x + dx < 0 || x + dx >= CHUNK_SIZE ||
+                z + dz < 0 || z + dz >= CHUNK_SIZE ||
+                abs(dx) + abs(dz) > 3) {
+                continue;
+            }
+            
+            for (int dy = 4; dy <= 7; dy++) {
+                uint8_t* block = block_at(blocks, x + dx, height + dy, z + dz);
+                if (*block == BLOCK_AIR) *block = BLOCK_LEAVES;
+            }
         }
     }
 }
@@ -120,7 +363,19 @@ TerrainGenerator* terrain_create(int seed) {
     if (!gen) return NULL;
     
     gen->seed = seed;
-    srand(seed);
+    
+    // Perlin noise repeats every 256 units, so a seed picks where in that
+    // period each octave samples from
+    for (int i = 0; i < TERRAIN_OCTAVES; i++) {
+        for (int axis = 0; axis < 2; axis++) {
+            uint64_t h = hash_position(seed, i, axis, 0, RANDOM_NOISE_OFFSET);
+            gen->octave_offset[i][axis] = (float)(h >> 40) / (float)(1 << 24) * 256.0f;
+        }
+    }
+    
+    for (int i = 0; i < 512; i++) {
+        gen->perm[i] = perm[i];
+    }
     
     return gen;
 }
@@ -129,19 +384,41 @@ void terrain_destroy(TerrainGenerator* gen) {
     free(gen);
 }
 
+// A pure function of (seed, chunk x, chunk z), safe to run on any thread
 void terrain_generate_chunk(TerrainGenerator* gen, Chunk* chunk) {
     if (!gen || !chunk) return;
     
+    // Heights reach TREE_RADIUS columns into the neighbors, so trees rooted
+    // there can be decorated here without the neighbors being loaded
+    int origin_x = chunk->x * CHUNK_SIZE - TREE_RADIUS;
+    int origin_z = chunk->z * CHUNK_SIZE - TREE_RADIUS;
+    int heights[DECORATION_SIZE * DECORATION_SIZE];
+    terrain_get_heightmap(gen, origin_x, origin_z, DECORATION_SIZE, DECORATION_SIZE, heights);
+    
+    // Built in a scratch buffer without any per-block chunk bookkeeping,
+    // then each section is packed once
+    ChunkBlocks blocks;
+    memset(blocks, BLOCK_AIR, sizeof(blocks));
+    
     for (int x = 0; x < CHUNK_SIZE; x++) {
         for (int z = 0; z < CHUNK_SIZE; z++) {
-            int world_x = chunk->x * CHUNK_SIZE + x;
-            int world_z = chunk->z * CHUNK_SIZE + z;
-            
-            int height = get_height(gen, world_x, world_z);
-            generate_column(gen, chunk, x, z, height);
+            int height = heights[(z + TREE_RADIUS) * DECORATION_SIZE + x + TREE_RADIUS];
+            generate_column(gen, chunk, blocks, x, z, height);
         }
     }
     
-    chunk->is_generated = true;
-    chunk->is_dirty = true;
+    // Trees go in world column order, so overlapping trees resolve the
+    // same way on both sides of a chunk border
+    for (int i = 0; i < DECORATION_SIZE; i++) {
+        for (int j = 0; j < DECORATION_SIZE; j++) {
+            int height = heights[j * DECORATION_SIZE + i];
+            if (has_tree(gen, origin_x + i, origin_z + j, height)) {
+                place_tree(blocks, i - TREE_RADIUS, j - TREE_RADIUS, height);
+            }
+        }
+    }
+    
+    for (int sy = 0; sy < CHUNK_SECTION_COUNT; sy++) {
+        chunk_write_section(chunk, sy, blocks[sy]);
+    }
 }
\ No newline at end of file
@@ -1,14 +1,21 @@
 #ifndef TERRAIN_H
 #define TERRAIN_H
 
+#include <stdint.h>
 #include "chunk.h"
 
 typedef struct {
     int seed;
+    // Noise-space origin of each octave, derived from the seed
+    float octave_offset[TERRAIN_OCTAVES][2];
+    // noise1234's permutation widened to 32 bits for SIMD gathers
+    int32_t perm[512];
 } TerrainGenerator;
 
 TerrainGenerator* terrain_create(int seed);
 void terrain_destroy(TerrainGenerator* gen);
+void terrain_get_heightmap(TerrainGenerator* gen, int origin_x, int origin_z,
+                           int width, int depth, int* heights);
 void terrain_generate_chunk(TerrainGenerator* gen, Chunk* chunk);
 
 #endif
\ No newline at end of file
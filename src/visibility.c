@@ -0,0 +1,167 @@
+#include "visibility.h"
+#include <string.h>
+
+// Bit of the pair (a, b) in a section graph, pairs ordered (0,1) .. (4,5)
+static inline int pair_bit(int a, int b) {
+    int low = a < b ? a : b;
+    int high = a < b ? b : a;
+    return low * (11 - low) / 2 + high - low - 1;
+}
+
+bool visibility_connected(uint16_t graph, int a, int b) {
+    if (a == b) return true;
+    return (graph >> pair_bit(a, b)) & 1;
+}
+
+uint16_t visibility_uniform_graph(BlockType fill) {
+    return block_is_transparent(fill) ? VISIBILITY_ALL : VISIBILITY_NONE;
+}
+
+static inline void flood_push(const uint8_t* blocks, const bool* see_through,
+                              uint64_t* visited, uint16_t* stack, int* top, int i) {
+    if (!see_through[blocks[i]] || (visited[i / 64] >> (i % 64)) & 1) return;
+    
+    visited[i / 64] |= 1ULL << (i % 64);
+    stack[(*top)++] = (uint16_t)i;
+}
+
+// Flood-fill the see-through blocks of a dense SECTION_INDEX-ordered
+// section. Every region joins all the faces it touches.
+uint16_t visibility_section_graph(const uint8_t* blocks) {
+    bool see_through[256];
+    for (int i = 0; i < 256; i++) {
+        see_through[i] = block_is_transparent((BlockType)i);
+    }
+    
+    uint64_t visited[CHUNK_SECTION_VOLUME / 64];
+    uint16_t stack[CHUNK_SECTION_VOLUME];
+    memset(visited, 0, sizeof(visited));
+    
+    uint16_t graph = VISIBILITY_NONE;
+    for (int start = 0; start < CHUNK_SECTION_VOLUME && graph != VISIBILITY_ALL; start++) {
+        int top = 0;
+        flood_push(blocks, see_through, visited, stack, &top, start);
+        if (top == 0) continue;
+        
+        int faces = 0;
+        while (top > 0) {
+            int i = stack[--top];
+            int x = SECTION_X(i);
+            int y = SECTION_Y(i);
+            int z = SECTION_Z(i);
+            
+            // Either spread to the neighbor or record the face reached
+            if (y == CHUNK_SECTION_HEIGHT - 1) faces |= 1 << 0;
+            else flood_push(blocks, see_through, visited, stack, &top, i + SECTION_STRIDE_Y);
+            if (y == 0) faces |= 1 << 1;
+            else flood_push(blocks, see_through, visited, stack, &top, i - SECTION_STRIDE_Y);
+            if (x == CHUNK_SIZE - 1) faces |= 1 << 2;
+            else flood_push(blocks, see_through, visited, stack, &top, i + SECTION_STRIDE_X);
+            if (x == 0) faces |= 1 << 3;
+            else flood_push(blocks, see_through, visited, stack, &top, i - SECTION_STRIDE_X);
+            if (z == CHUNK_SIZE - 1) faces |= 1 << 4;
+            else flood_push(blocks, see_through, visited, stack, &top, i + SECTION_STRIDE_Z);
+            if (z == 0) faces |= 1 << 5;
+            else flood_push(blocks, see_through, visited, stack, &top, i - SECTION_STRIDE_Z);
+        }
+        
+        for (int a = 0; a < VISIBILITY_FACES; a++) {
+            if (!(faces & (1 << a))) continue;
+            for (int b = a + 1; b < VISIBILITY_FACES; b++) {
+                if (faces & (1 << b)) graph |= 1 << pair_bit(a, b);
+            }
+        }
+    }
+    
+    return graph;
+}
+
+// Section across the given face, NULL at the edge of the loaded world
+static Chunk* step(Chunk* chunk, int section_y, int face, int* next_y) {
+    *next_y = section_y;
+    switch (face) {
+        case 0:
+            *next_y = section_y + 1;
+            return *next_y < CHUNK_SECTION_COUNT ? chunk : NULL;
+        case 1:
+            *next_y = section_y - 1;
+            return *next_y >= 0 ? chunk : NULL;
+        case 2: return chunk->east;
+        case 3: return chunk->west;
+        case 4: return chunk->south;
+        default: return chunk->north;
+    }
+}
+
+static inline bool is_reached(const VisibilityTraversal* traversal, const Chunk* chunk,
+                              int section_y) {
+    return chunk->visibility_frame == traversal->frame &&
+           (chunk->visible_sections >> section_y) & 1;
+}
+
+static inline void mark_reached(const VisibilityTraversal* traversal, Chunk* chunk,
+                                int section_y) {
+    if (chunk->visibility_frame != traversal->frame) {
+        chunk->visibility_frame = traversal->frame;
+        chunk->visible_sections = 0;
+    }
+    chunk->visible_sections |= (uint16_t)(1 << section_y);
+}
+
+// Breadth-first walk from the camera's section through faces its graph
+// connects, never stepping back toward the camera, and skipping sections
+// outside the frustum if one is given. Sections left unmarked can't be
+// seen. Returns false if the walk couldn't run or was cut short, in which
+// case the marks mean nothing.
+bool visibility_traverse(VisibilityTraversal* traversal, Chunk* start, int section_y,
+                         const Frustum* frustum) {
+    traversal->frame++;
+    traversal->sections_reached = 0;
+    
+    if (!start || !start->is_generated) return false;
+    if (section_y < 0 || section_y >= CHUNK_SECTION_COUNT) return false;
+    if (traversal->capacity < 1) return false;
+    
+    VisibilityNode* queue = traversal->queue;
+    int head = 0;
+    int tail = 0;
+    
+    // The camera sees out of its own section through every face
+    mark_reached(traversal, start, section_y);
+    queue[tail++] = (VisibilityNode){start, (uint8_t)section_y, VISIBILITY_FACES, 0};
+    
+    while (head < tail) {
+        VisibilityNode node = queue[head++];
+        uint16_t graph = chunk_section_graph(node.chunk, node.section_y);
+        
+        for (int face = 0; face < VISIBILITY_FACES; face++) {
+            if (node.directions & (1 << VISIBILITY_OPPOSITE(face))) continue;
+            if (node.entered < VISIBILITY_FACES &&
+                !visibility_connected(graph, node.entered, face)) continue;
+            
+            int next_y;
+            Chunk* next = step(node.chunk, node.section_y, face, &next_y);
+            if (!next || !next->is_generated) continue;
+            if (is_reached(traversal, next, next_y)) continue;
+            
+            if (frustum) {
+                float min[3] = {(float)(next->x * CHUNK_SIZE),
+                                (float)(next_y * CHUNK_SECTION_HEIGHT),
+                                (float)(next->z * CHUNK_SIZE)};
+                float max[3] = {min[0] + CHUNK_SIZE, min[1] + CHUNK_SECTION_HEIGHT,
+                                min[2] + CHUNK_SIZE};
+                if (!frustum_test_box(frustum, min, max)) continue;
+            }
+            
+            if (tail == traversal->capacity) return false;
+            
+            mark_reached(traversal, next, next_y);
+            queue[tail++] = (VisibilityNode){next, (uint8_t)next_y,
+                                             (uint8_t)VISIBILITY_OPPOSITE(face),
+                                             (uint8_t)(node.directions | (1 << face))};
+        }
+    }
+    
+    traversal->sections_reached = tail;
+    return true;
+}
\ No newline at end of file
@@ -0,0 +1,43 @@
+#ifndef VISIBILITY_H
+#define VISIBILITY_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "chunk.h"
+#include "frustum.h"
+
+// Faces of a section, in the mesher's order: top, bottom, east, west,
+// south, north. Opposite faces differ only in the lowest bit.
+#define VISIBILITY_FACES 6
+#define VISIBILITY_OPPOSITE(face) ((face) ^ 1)
+
+// A section's graph has one bit per unordered pair of faces, set when a
+// path of see-through blocks inside the section joins the two
+#define VISIBILITY_NONE 0
+#define VISIBILITY_ALL 0x7FFF
+
+// A section waiting in the traversal, entered through the given face
+// after stepping in the given directions (one bit per face)
+typedef struct {
+    Chunk* chunk;
+    uint8_t section_y;
+    uint8_t entered;
+    uint8_t directions;
+} VisibilityNode;
+
+// Marks reached sections in Chunk::visible_sections, valid for chunks
+// whose visibility_frame matches frame
+typedef struct {
+    VisibilityNode* queue;
+    int capacity;
+    uint32_t frame;
+    int sections_reached;
+} VisibilityTraversal;
+
+uint16_t visibility_section_graph(const uint8_t* blocks);
+uint16_t visibility_uniform_graph(BlockType fill);
+bool visibility_connected(uint16_t graph, int a, int b);
+bool visibility_traverse(VisibilityTraversal* traversal, Chunk* start, int section_y,
+                         const Frustum* frustum);
+
+#endif
\ No newline at end of file
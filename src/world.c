@@ -1,6 +1,10 @@
 #include "world.h"
 #include "terrain.h"
+#include "crc32c.h"
 #include <stdlib.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
 #include <math.h>
 #include <stdio.h>
 
@@ -9,12 +13,16 @@ World* world_create(int seed) {
     if (!world) return NULL;
     
     world->chunk_count = 0;
+    world->pool_count = 0;
     world->seed = seed;
     world->terrain_gen = terrain_create(seed);
+    world->async_generation = false;
+    world->store = NULL;
     
     for (int i = 0; i < MAX_CHUNKS; i++) {
         world->chunks[i] = NULL;
     }
+    memset(world->chunk_table, 0, sizeof(world->chunk_table));
     
     return world;
 }
@@ -22,28 +30,73 @@ World* world_create(int seed) {
 void world_destroy(World* world) {
     if (!world) return;
     
-    // Free all chunks
+    // Free all chunks, including pooled ones
     for (int i = 0; i < world->chunk_count; i++) {
         chunk_destroy(world->chunks[i]);
     }
+    for (int i = 0; i < world->pool_count; i++) {
+        chunk_destroy(world->chunk_pool[i]);
+    }
     
     // Free terrain generator
     terrain_destroy((TerrainGenerator*)world->terrain_gen);
+    region_store_close(world->store);
     
     free(world);
 }
 
+// Fibonacci hash of the packed chunk coordinates
+static uint32_t chunk_table_hash(int chunk_x, int chunk_z) {
+    uint64_t key = ((uint64_t)(uint32_t)chunk_x << 32) | (uint32_t)chunk_z;
+    return (uint32_t)((key * 0x9E3779B97F4A7C15ULL) >> (64 - CHUNK_TABLE_BITS));
+}
+
 Chunk* world_find_chunk(World* world, int chunk_x, int chunk_z) {
     if (!world) return NULL;
     
-    for (int i = 0; i < world->chunk_count; i++) {
-        Chunk* chunk = world->chunks[i];
-        if (chunk && chunk->x == chunk_x && chunk->z == chunk_z) {
+    uint32_t slot = chunk_table_hash(chunk_x, chunk_z);
+    for (;;) {
+        Chunk* chunk = world->chunk_table[slot];
+        if (!chunk) return NULL;
+        if (chunk->x == chunk_x && chunk->z == chunk_z) {
             return chunk;
         }
+        slot = (slot + 1) & (CHUNK_TABLE_SIZE - 1);
+    }
+}
+
+static void chunk_table_insert(World* world, Chunk* chunk) {
+    uint32_t slot = chunk_table_hash(chunk->x, chunk->z);
+    while (world->chunk_table[slot]) {
+        slot = (slot + 1) & (CHUNK_TABLE_SIZE - 1);
+    }
+    world->chunk_table[slot] = chunk;
+}
+
+static void chunk_table_remove(World* world, Chunk* chunk) {
+    uint32_t slot = chunk_table_hash(chunk->x, chunk->z);
+    while (world->chunk_table[slot] != chunk) {
+        if (!world->chunk_table[slot]) return;
+        slot = (slot + 1) & (CHUNK_TABLE_SIZE - 1);
     }
     
-    return NULL;
+    // Backward-shift deletion: pull later entries of the probe run into
+    // the hole so lookups never need tombstones
+    uint32_t hole = slot;
+    for (;;) {
+        slot = (slot + 1) & (CHUNK_TABLE_SIZE - 1);
+        Chunk* next = world->chunk_table[slot];
+        if (!next) break;
+        
+        uint32_t home = chunk_table_hash(next->x, next->z);
+        // Move only if the hole lies cyclically between home and slot
+        if (((slot - home) & (CHUNK_TABLE_SIZE - 1)) >=
+            ((slot - hole) & (CHUNK_TABLE_SIZE - 1))) {
+            world->chunk_table[hole] = next;
+            hole = slot;
+        }
+    }
+    world->chunk_table[hole] = NULL;
 }
 
 static void setup_chunk_neighbors(World* world, Chunk* chunk) {
@@ -59,13 +112,58 @@ static void setup_chunk_neighbors(World* world, Chunk* chunk) {
     if (chunk->west) chunk->west->east = chunk;
 }
 
+static void unlink_chunk_neighbors(Chunk* chunk) {
+    if (chunk->north) chunk->north->south = NULL;
+    if (chunk->south) chunk->south->north = NULL;
+    if (chunk->east) chunk->east->west = NULL;
+    if (chunk->west) chunk->west->east = NULL;
+    
+    chunk->north = NULL;
+    chunk->south = NULL;
+    chunk->east = NULL;
+    chunk->west = NULL;
+}
+
+// Take a chunk from the pool, falling back to a fresh allocation
+static Chunk* acquire_chunk(World* world, int chunk_x, int chunk_z) {
+    if (world->pool_count > 0) {
+        Chunk* chunk = world->chunk_pool[--world->pool_count];
+        chunk_reset(chunk, chunk_x, chunk_z);
+        return chunk;
+    }
+    
+    return chunk_create(chunk_x, chunk_z);
+}
+
+static void release_chunk(World* world, Chunk* chunk) {
+    if (world->pool_count < MAX_CHUNKS) {
+        world->chunk_pool[world->pool_count++] = chunk;
+    } else {
+        chunk_destroy(chunk);
+    }
+}
+
 void world_add_chunk(World* world, Chunk* chunk) {
     if (!world || !chunk || world->chunk_count >= MAX_CHUNKS) return;
     
     world->chunks[world->chunk_count++] = chunk;
+    chunk_table_insert(world, chunk);
     setup_chunk_neighbors(world, chunk);
 }
 
+void world_remove_chunk(World* world, Chunk* chunk) {
+    if (!world || !chunk) return;
+    
+    for (int i = 0; i < world->chunk_count; i++) {
+        if (world->chunks[i] == chunk) {
+            world->chunks[i] = world->chunks[--world->chunk_count];
+            world->chunks[world->chunk_count] = NULL;
+            chunk_table_remove(world, chunk);
+            return;
+        }
+    }
+}
+
 Chunk* world_get_chunk(World* world, int chunk_x, int chunk_z) {
     if (!world) return NULL;
     
@@ -73,20 +171,88 @@ Chunk* world_get_chunk(World* world, int chunk_x, int chunk_z) {
     Chunk* chunk = world_find_chunk(world, chunk_x, chunk_z);
     if (chunk) return chunk;
     
+    // Refuse to create chunks once the world is full, they'd never be added
+    if (world->chunk_count >= MAX_CHUNKS) return NULL;
+    
     // Create new chunk
-    chunk = chunk_create(chunk_x, chunk_z);
+    chunk = acquire_chunk(world, chunk_x, chunk_z);
     if (!chunk) return NULL;
     
     world_add_chunk(world, chunk);
     
-    // Generate terrain if not loaded
-    if (!chunk->is_generated) {
-        terrain_generate_chunk((TerrainGenerator*)world->terrain_gen, chunk);
+    // Generate terrain now unless the job system will pick it up
+    if (!world->async_generation) {
+        chunk->state = CHUNK_STATE_GENERATING;
+        world_fill_chunk(world, chunk);
+        world_publish_chunk(world, chunk);
     }
     
     return chunk;
 }
 
+// Fill a freshly reset chunk from the save when it holds one, otherwise
+// from the terrain generator. Touches only the chunk and the locked store,
+// so it runs on worker threads too.
+void world_fill_chunk(World* world, Chunk* chunk) {
+    if (!world || !chunk) return;
+    
+    TerrainGenerator* terrain = (TerrainGenerator*)world->terrain_gen;
+    if (world->store && region_read_chunk(world->store, chunk, terrain)) return;
+    
+    terrain_generate_chunk(terrain, chunk);
+}
+
+// Make freshly generated blocks visible to the rest of the game. Neighbors
+// meshed while this chunk was missing drew their border faces, so they
+// are remeshed too.
+void world_publish_chunk(World* world, Chunk* chunk) {
+    if (!world || !chunk) return;
+    
+    chunk->state = CHUNK_STATE_GENERATED;
+    chunk->is_generated = true;
+    chunk->is_dirty = true;
+    
+    Chunk* neighbors[4] = {chunk->north, chunk->south, chunk->east, chunk->west};
+    for (int i = 0; i < 4; i++) {
+        if (neighbors[i] && neighbors[i]->is_generated) {
+            neighbors[i]->is_dirty = true;
+        }
+    }
+}
+
+// Chunks waiting for generation, nearest to the player first
+int world_get_queued_chunks(World* world, float player_x, float player_z,
+                            Chunk** out_chunks, int max_count) {
+    if (!world || !out_chunks || max_count <= 0) return 0;
+    
+    int player_chunk_x = (int)floor(player_x / CHUNK_SIZE);
+    int player_chunk_z = (int)floor(player_z / CHUNK_SIZE);
+    
+    int distances[MAX_CHUNKS];
+    int count = 0;
+    for (int i = 0; i < world->chunk_count; i++) {
+        Chunk* chunk = world->chunks[i];
+        if (chunk->state != CHUNK_STATE_QUEUED) continue;
+        
+        int dx = chunk->x - player_chunk_x;
+        int dz = chunk->z - player_chunk_z;
+        int distance = dx * dx + dz * dz;
+        if (count == max_count && distance >= distances[count - 1]) continue;
+        
+        // Insertion into the short sorted output
+        int j = (count < max_count) ? count++ : count - 1;
+        while (j > 0 && distances[j - 1] > distance) {
+            distances[j] = distances[j - 1];
+            out_chunks[j] = out_chunks[j - 1];
+            j--;
+        }
+        distances[j] = distance;
+        out_chunks[j] = chunk;
+    }
+    
+    return count;
+}
+
 BlockType world_get_block(World* world, int x, int y, int z) {
     if (!world || y < 0 || y >= CHUNK_HEIGHT) {
         return BLOCK_AIR;
@@ -157,8 +323,53 @@ void world_update_chunks(World* world, float player_x, float player_z) {
         }
     }
     
-    // Unload distant chunks (simple version - don't unload for now)
-    // In a real implementation, you'd remove chunks beyond render distance + margin
+    // Distant chunks are unloaded by the engine through world_get_distant_chunks,
+    // since their meshes must be released by the renderer first
+}
+
+int world_get_distant_chunks(World* world, float player_x, float player_z,
+                             Chunk** out_chunks, int max_count) {
+    if (!world || !out_chunks) return 0;
+    
+    int player_chunk_x = (int)floor(player_x / CHUNK_SIZE);
+    int player_chunk_z = (int)floor(player_z / CHUNK_SIZE);
+    int unload_distance = RENDER_DISTANCE + CHUNK_UNLOAD_MARGIN;
+    
+    int count = 0;
+    for (int i = 0; i < world->chunk_count && count < max_count; i++) {
+        Chunk* chunk = world->chunks[i];
+        
+        // Workers still hold these, they go once their job comes back
+        if (chunk->state == CHUNK_STATE_GENERATING ||
+            chunk->state == CHUNK_STATE_MESHING) {
+            continue;
+        }
+        
+        // Edits still on their way to the save, or that failed to get
+        // there and wait for the next autosave to retry
+        if (chunk->is_saving || chunk->save_failed) continue;
+        
+        // Without a save directory, edits live only in memory
+        if (chunk->is_modified && !world->store) continue;
+        
+        if (abs(chunk->x - player_chunk_x) > unload_distance ||
+            abs(chunk->z - player_chunk_z) > unload_distance) {
+            out_chunks[count++] = chunk;
+        }
+    }
+    
+    return count;
+}
+
+// Let a chunk go. Edited chunks are saved by the engine's workers before
+// they get here, and without a save directory they're never handed out by
+// world_get_distant_chunks.
+void world_unload_chunk(World* world, Chunk* chunk) {
+    if (!world || !chunk) return;
+    
+    unlink_chunk_neighbors(chunk);
+    world_remove_chunk(world, chunk);
+    release_chunk(world, chunk);
 }
 
 int world_get_dirty_chunks(World* world, Chunk** out_chunks, int max_count) {
@@ -167,7 +378,8 @@ int world_get_dirty_chunks(World* world, Chunk** out_chunks, int max_count) {
     int count = 0;
     for (int i = 0; i < world->chunk_count && count < max_count; i++) {
         Chunk* chunk = world->chunks[i];
-        if (chunk && chunk->is_dirty && chunk->is_generated) {
+        if (chunk && chunk->is_dirty && chunk->is_generated &&
+            chunk->state != CHUNK_STATE_MESHING) {
             out_chunks[count++] = chunk;
         }
     }
@@ -219,71 +431,154 @@ bool world_raycast(World* world, float* origin, float* direction,
     return false;
 }
 
-bool world_save(World* world, const char* filename) {
-    if (!world) return false;
-    
-    FILE* file = fopen(filename, "wb");
+#define LEVEL_MAGIC 0x564C5856              // "VXLV"
+#define LEVEL_VERSION 1
+
+// Contents of level.dat
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    int32_t seed;
+    uint32_t checksum;                      // CRC-32C of the fields above
+} LevelData;
+
+typedef enum {
+    LEVEL_OK,
+    LEVEL_MISSING,
+    LEVEL_DAMAGED
+} LevelStatus;
+
+// Written beside the old file and renamed over it, so a crash never
+// leaves a truncated level.dat
+static bool write_level(World* world) {
+    char filename[sizeof(world->store->path) + 16];
+    char temp_filename[sizeof(filename) + 4];
+    snprintf(filename, sizeof(filename), "%s/level.dat", world->store->path);
+    snprintf(temp_filename, sizeof(temp_filename), "%s.tmp", filename);
+    
+    LevelData level;
+    level.magic = LEVEL_MAGIC;
+    level.version = LEVEL_VERSION;
+    level.seed = world->seed;
+    level.checksum = crc32c(&level, offsetof(LevelData, checksum));
+    
+    FILE* file = fopen(temp_filename, "wb");
     if (!file) return false;
     
-    // Write seed
-    fwrite(&world->seed, sizeof(int), 1, file);
+    if (fwrite(&level, sizeof(level), 1, file) != 1) {
+        fclose(file);
+        remove(temp_filename);
+        return false;
+    }
     
-    // Write chunk count
-    fwrite(&world->chunk_count, sizeof(int), 1, file);
+    return region_commit_file(file, temp_filename, filename);
+}
+
+// Adopt the seed stored with the save
+static LevelStatus read_level(World* world) {
+    char filename[sizeof(world->store->path) + 16];
+    snprintf(filename, sizeof(filename), "%s/level.dat", world->store->path);
     
-    // Write each chunk
-    for (int i = 0; i < world->chunk_count; i++) {
-        Chunk* chunk = world->chunks[i];
-        if (chunk && chunk->is_generated) {
-            fwrite(&chunk->x, sizeof(int), 1, file);
-            fwrite(&chunk->z, sizeof(int), 1, file);
-            fwrite(chunk->blocks, sizeof(chunk->blocks), 1, file);
-        }
-    }
+    FILE* file = fopen(filename, "rb");
+    if (!file) return LEVEL_MISSING;
     
+    LevelData level;
+    bool ok = fread(&level, sizeof(level), 1, file) == 1;
     fclose(file);
-    printf("World saved: %d chunks\n", world->chunk_count);
-    return true;
+    
+    if (!ok || level.magic != LEVEL_MAGIC || level.version != LEVEL_VERSION ||
+        level.checksum != crc32c(&level, offsetof(LevelData, checksum))) {
+        return LEVEL_DAMAGED;
+    }
+    
+    if (level.seed != world->seed) {
+        terrain_destroy((TerrainGenerator*)world->terrain_gen);
+        world->seed = level.seed;
+        world->terrain_gen = terrain_create(level.seed);
+    }
+    
+    return LEVEL_OK;
 }
 
-bool world_load(World* world, const char* filename) {
+// Attach a save directory, created if missing. A seed stored there
+// replaces the world's, so call this before any chunk is generated.
+bool world_open(World* world, const char* path) {
     if (!world) return false;
     
-    FILE* file = fopen(filename, "rb");
-    if (!file) {
-        printf("Save file not found: %s\n", filename);
+    RegionStore* store = region_store_open(path);
+    if (!store) return false;
+    
+    region_store_close(world->store);
+    world->store = store;
+    
+    LevelStatus status = read_level(world);
+    
+    // Without the right seed, saved edits would land on the wrong terrain
+    if (status == LEVEL_DAMAGED) {
+        fprintf(stderr, "Damaged level file in save: %s\n", path);
+        region_store_close(world->store);
+        world->store = NULL;
         return false;
     }
     
-    // Clear existing chunks
+    if (status == LEVEL_MISSING && !write_level(world)) {
+        fprintf(stderr, "Failed to write save: %s\n", path);
+        return false;
+    }
+    
+    return true;
+}
+
+// Write the chunks edited since they were last saved; unmodified chunks
+// are either in the save already or regenerate identically from the seed
+bool world_save(World* world) {
+    if (!world || !world->store) return false;
+    
+    bool ok = write_level(world);
+    int written = 0;
+    size_t bytes = 0;
+    
+    for (int i = 0; i < world->chunk_count; i++) {
+        Chunk* chunk = world->chunks[i];
+        if (chunk->is_generated && chunk->is_modified) {
+            size_t length = region_write_chunk(world->store, chunk,
+                                               (TerrainGenerator*)world->terrain_gen);
+            if (length) {
+                chunk->is_modified = false;
+                chunk->save_failed = false;
+                written++;
+                bytes += length;
+            } else {
+                ok = false;
+            }
+        }
+    }
+    
+    region_store_flush(world->store);
+    printf("World saved: %d chunks written, %.1f KiB\n", written, bytes / 1024.0);
+    return ok;
+}
+
+// Go back to the saved world. Resident chunks are dropped, unsaved edits
+// included, and reload from the save as they're needed again. The caller
+// makes sure no job still uses them.
+bool world_load(World* world) {
+    if (!world || !world->store) return false;
+    
     for (int i = 0; i < world->chunk_count; i++) {
-        chunk_destroy(world->chunks[i]);
+        release_chunk(world, world->chunks[i]);
         world->chunks[i] = NULL;
     }
     world->chunk_count = 0;
+    memset(world->chunk_table, 0, sizeof(world->chunk_table));
     
-    // Read seed
-    fread(&world->seed, sizeof(int), 1, file);
-    
-    // Read chunk count
-    int chunk_count;
-    fread(&chunk_count, sizeof(int), 1, file);
-    
-    // Read each chunk
-    for (int i = 0; i < chunk_count; i++) {
-        int x, z;
-        fread(&x, sizeof(int), 1, file);
-        fread(&z, sizeof(int), 1, file);
-        
-        Chunk* chunk = chunk_create(x, z);
-        fread(chunk->blocks, sizeof(chunk->blocks), 1, file);
-        chunk->is_generated = true;
-        chunk->is_dirty = true;
-        
-        world_add_chunk(world, chunk);
+    LevelStatus status = read_level(world);
+    if (status != LEVEL_OK) {
+        printf("%s: %s\n", status == LEVEL_MISSING ? "Save not found" : "Damaged save",
+               world->store->path);
+        return false;
     }
     
-    fclose(file);
-    printf("World loaded: %d chunks\n", world->chunk_count);
+    printf("World loaded: %s\n", world->store->path);
     return true;
 }
\ No newline at end of file
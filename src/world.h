@@ -3,15 +3,39 @@
 
 #include <stdbool.h>
 #include "chunk.h"
+#include "region.h"
 #include "config.h"
 
+#ifndef MAX_CHUNKS
 #define MAX_CHUNKS 1024
+#endif
+
+// Open-addressing table indexed by packed (chunk_x, chunk_z).
+// Kept at most half full so linear probes stay short. Both sizes can be
+// raised at build time, as the world benchmark does.
+#ifndef CHUNK_TABLE_BITS
+#define CHUNK_TABLE_BITS 11
+#endif
+#define CHUNK_TABLE_SIZE (1 << CHUNK_TABLE_BITS)
+
+#if CHUNK_TABLE_SIZE < 2 * MAX_CHUNKS
+#error "The chunk table must have at least twice MAX_CHUNKS slots"
+#endif
 
 typedef struct {
     Chunk* chunks[MAX_CHUNKS];
     int chunk_count;
+    Chunk* chunk_table[CHUNK_TABLE_SIZE];
+    // Unloaded chunks kept for reuse so steady-state streaming doesn't malloc
+    Chunk* chunk_pool[MAX_CHUNKS];
+    int pool_count;
     int seed;
     void* terrain_gen;
+    // Save directory chunks are loaded from on demand, NULL if none
+    RegionStore* store;
+    // New chunks are left QUEUED for the engine's workers instead of
+    // being generated inline by world_get_chunk
+    bool async_generation;
 } World;
 
 World* world_create(int seed);
@@ -19,14 +43,23 @@ void world_destroy(World* world);
 Chunk* world_get_chunk(World* world, int chunk_x, int chunk_z);
 Chunk* world_find_chunk(World* world, int chunk_x, int chunk_z);
 void world_add_chunk(World* world, Chunk* chunk);
+void world_remove_chunk(World* world, Chunk* chunk);
+void world_fill_chunk(World* world, Chunk* chunk);
+void world_publish_chunk(World* world, Chunk* chunk);
+int world_get_queued_chunks(World* world, float player_x, float player_z,
+                            Chunk** out_chunks, int max_count);
 BlockType world_get_block(World* world, int x, int y, int z);
 bool world_set_block(World* world, int x, int y, int z, BlockType type);
 void world_update_chunks(World* world, float player_x, float player_z);
+int world_get_distant_chunks(World* world, float player_x, float player_z,
+                             Chunk** out_chunks, int max_count);
+void world_unload_chunk(World* world, Chunk* chunk);
 int world_get_dirty_chunks(World* world, Chunk** out_chunks, int max_count);
 bool world_raycast(World* world, float* origin, float* direction, 
                    int* hit_x, int* hit_y, int* hit_z,
                    int* prev_x, int* prev_y, int* prev_z);
-bool world_save(World* world, const char* filename);
-bool world_load(World* world, const char* filename);
+bool world_open(World* world, const char* path);
+bool world_save(World* world);
+bool world_load(World* world);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,112 @@
+#include "codec.h"
+#include "terrain.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Size and speed of saved chunk records over a square of seed-12345
+// chunks, each with a few player edits. Whole-chunk run records are
+// encoded without a generator, edit records with one; both are measured
+// against the chunk's 64 KiB of raw blocks. Edit records regenerate the
+// terrain on either side, which is most of their time.
+#define BENCH_SEED 12345
+#define GRID 12
+#define GRID_CHUNKS (GRID * GRID)
+#define EDITS_PER_CHUNK 64
+#define RAW_SIZE (CHUNK_SIZE * CHUNK_HEIGHT * CHUNK_SIZE)
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static bool same_blocks(Chunk* a, Chunk* b) {
+    for (int sy = 0; sy < CHUNK_SECTION_COUNT; sy++) {
+        uint8_t blocks_a[CHUNK_SECTION_VOLUME];
+        uint8_t blocks_b[CHUNK_SECTION_VOLUME];
+        chunk_read_section(a, sy, blocks_a);
+        chunk_read_section(b, sy, blocks_b);
+        if (memcmp(blocks_a, blocks_b, sizeof(blocks_a)) != 0) return false;
+    }
+    return true;
+}
+
+// Encode and decode every chunk with or without a generator to diff
+// against, checking the blocks come back
+static bool bench_mode(const char* name, Chunk** chunks, TerrainGenerator* gen,
+                       CodecScratch* scratch) {
+    static uint8_t record[CODEC_MAX_SIZE];
+    uint8_t* records[GRID_CHUNKS];
+    size_t lengths[GRID_CHUNKS];
+    size_t total = 0;
+    
+    double start = now_seconds();
+    for (int i = 0; i < GRID_CHUNKS; i++) {
+        lengths[i] = codec_encode_chunk(chunks[i], gen, record, scratch);
+        records[i] = (uint8_t*)malloc(lengths[i]);
+        if (!records[i]) return false;
+        memcpy(records[i], record, lengths[i]);
+        total += lengths[i];
+    }
+    double encode = now_seconds() - start;
+    
+    Chunk* decoded = chunk_create(0, 0);
+    bool ok = true;
+    start = now_seconds();
+    for (int i = 0; i < GRID_CHUNKS; i++) {
+        chunk_reset(decoded, chunks[i]->x, chunks[i]->z);
+        ok = codec_decode_chunk(decoded, gen, records[i], lengths[i], scratch) && ok;
+    }
+    double decode = now_seconds() - start;
+    
+    for (int i = 0; i < GRID_CHUNKS && ok; i++) {
+        chunk_reset(decoded, chunks[i]->x, chunks[i]->z);
+        ok = codec_decode_chunk(decoded, gen, records[i], lengths[i], scratch) &&
+             same_blocks(decoded, chunks[i]);
+    }
+    if (!ok) fprintf(stderr, "%s records didn't decode to the saved blocks\n", name);
+    
+    double raw_mb = (double)RAW_SIZE * GRID_CHUNKS / (1024.0 * 1024.0);
+    printf("%-5s %7.0f bytes/chunk, %6.1fx smaller, encode %7.1f MB/s, decode %7.1f MB/s\n",
+           name, (double)total / GRID_CHUNKS, (double)RAW_SIZE * GRID_CHUNKS / total,
+           raw_mb / encode, raw_mb / decode);
+    
+    for (int i = 0; i < GRID_CHUNKS; i++) free(records[i]);
+    chunk_destroy(decoded);
+    return ok;
+}
+
+int main(void) {
+    blocks_init();
+    TerrainGenerator* terrain = terrain_create(BENCH_SEED);
+    CodecScratch* scratch = codec_scratch_create();
+    if (!terrain || !scratch) return 1;
+    
+    // Some digging and building in every chunk
+    Chunk* chunks[GRID_CHUNKS];
+    uint32_t state = 1;
+    for (int i = 0; i < GRID_CHUNKS; i++) {
+        chunks[i] = chunk_create(i % GRID - GRID / 2, i / GRID - GRID / 2);
+        terrain_generate_chunk(terrain, chunks[i]);
+        
+        for (int e = 0; e < EDITS_PER_CHUNK; e++) {
+            state = state * 1664525u + 1013904223u;
+            int x = (state >> 8) % CHUNK_SIZE;
+            int z = (state >> 12) % CHUNK_SIZE;
+            int y = 40 + (state >> 16) % 60;
+            chunk_set_block(chunks[i], x, y, z, e % 2 ? BLOCK_AIR : BLOCK_PLANKS);
+        }
+    }
+    
+    printf("%d chunks, %d edits each, %d KiB raw\n", GRID_CHUNKS, EDITS_PER_CHUNK,
+           RAW_SIZE / 1024);
+    bool ok = bench_mode("runs", chunks, NULL, scratch);
+    ok = bench_mode("edits", chunks, terrain, scratch) && ok;
+    
+    for (int i = 0; i < GRID_CHUNKS; i++) chunk_destroy(chunks[i]);
+    codec_scratch_destroy(scratch);
+    terrain_destroy(terrain);
+    return ok ? 0 : 1;
+}
\ No newline at end of file
@@ -0,0 +1,137 @@
+#include "world.h"
+#include "terrain.h"
+#include "mesh.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <math.h>
+#include <time.h>
+
+// Generation, meshing and raycast throughput under the block layout this
+// is built with. `make bench` builds one per CHUNK_LAYOUT, run them all
+// on the same machine to compare:
+//   build/bench_layout_XYZ; build/bench_layout_XZY; build/bench_layout_YZX
+#define BENCH_SEED 12345
+#define RADIUS 8
+#define GRID (2 * RADIUS + 1)
+#define GRID_CHUNKS (GRID * GRID)
+#define RAYCASTS 200000
+
+static const char* layout_name(void) {
+#if CHUNK_LAYOUT == CHUNK_LAYOUT_XZY
+    return "XZY";
+#elif CHUNK_LAYOUT == CHUNK_LAYOUT_YZX
+    return "YZX";
+#else
+    return "XYZ";
+#endif
+}
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static uint32_t random_state = 1;
+
+static float next_unit(void) {
+    random_state = random_state * 1664525u + 1013904223u;
+    return (float)(random_state >> 8) / (float)(1 << 24);
+}
+
+static double bench_generation(TerrainGenerator* terrain) {
+    Chunk* chunk = chunk_create(0, 0);
+    double start = now_seconds();
+    for (int i = 0; i < GRID_CHUNKS; i++) {
+        chunk_reset(chunk, i % GRID - RADIUS, i / GRID - RADIUS);
+        terrain_generate_chunk(terrain, chunk);
+    }
+    double elapsed = now_seconds() - start;
+    chunk_destroy(chunk);
+    return elapsed;
+}
+
+// The loaded chunks have their neighbors linked, as in the game
+static double bench_meshing(World* world, MeshMode mode, long* quads) {
+    *quads = 0;
+    double start = now_seconds();
+    for (int i = 0; i < world->chunk_count; i++) {
+        MeshData data;
+        if (mesh_generate(world->chunks[i], mode, &data)) {
+            *quads += data.vertex_count / 4;
+            mesh_data_free(&data);
+        }
+    }
+    return now_seconds() - start;
+}
+
+// world_raycast from random points a little above the surface, looking
+// down at random angles, so each ray walks through a few blocks
+static double bench_raycast(World* world, int* hits) {
+    *hits = 0;
+    float (*rays)[6] = malloc(RAYCASTS * sizeof(*rays));
+    if (!rays) return 0.0;
+    
+    float extent = (float)(GRID * CHUNK_SIZE) - 2.0f;
+    for (int i = 0; i < RAYCASTS; i++) {
+        float* ray = rays[i];
+        ray[0] = -RADIUS * CHUNK_SIZE + 1.0f + next_unit() * extent;
+        ray[2] = -RADIUS * CHUNK_SIZE + 1.0f + next_unit() * extent;
+        
+        int top = CHUNK_HEIGHT - 1;
+        while (top > 0 && world_get_block(world, (int)floorf(ray[0]), top,
+                                          (int)floorf(ray[2])) == BLOCK_AIR) {
+            top--;
+        }
+        ray[1] = (float)top + 1.0f + next_unit() * 3.0f;
+        
+        float angle = next_unit() * 6.2831853f;
+        float pitch = 0.2f + next_unit() * 1.2f;
+        ray[3] = cosf(angle) * cosf(pitch);
+        ray[4] = -sinf(pitch);
+        ray[5] = sinf(angle) * cosf(pitch);
+    }
+    
+    double start = now_seconds();
+    for (int i = 0; i < RAYCASTS; i++) {
+        int hit[3], previous[3];
+        *hits += world_raycast(world, rays[i], rays[i] + 3, &hit[0], &hit[1], &hit[2],
+                               &previous[0], &previous[1], &previous[2]);
+    }
+    double elapsed = now_seconds() - start;
+    
+    free(rays);
+    return elapsed;
+}
+
+int main(void) {
+    blocks_init();
+    World* world = world_create(BENCH_SEED);
+    if (!world) return 1;
+    
+    for (int x = -RADIUS; x <= RADIUS; x++) {
+        for (int z = -RADIUS; z <= RADIUS; z++) {
+            world_get_chunk(world, x, z);
+        }
+    }
+    
+    printf("layout %s, %d chunks\n", layout_name(), GRID_CHUNKS);
+    
+    double generation = bench_generation((TerrainGenerator*)world->terrain_gen);
+    printf("  generation  %8.3f ms/chunk\n", generation * 1000.0 / GRID_CHUNKS);
+    
+    long quads;
+    double naive = bench_meshing(world, MESH_MODE_NAIVE, &quads);
+    printf("  naive mesh  %8.3f ms/chunk, %ld quads\n", naive * 1000.0 / GRID_CHUNKS, quads);
+    double greedy = bench_meshing(world, MESH_MODE_GREEDY, &quads);
+    printf("  greedy mesh %8.3f ms/chunk, %ld quads\n", greedy * 1000.0 / GRID_CHUNKS, quads);
+    
+    int hits;
+    double raycast = bench_raycast(world, &hits);
+    printf("  raycast     %8.3f us/ray, %d of %d hit\n",
+           raycast * 1e6 / RAYCASTS, hits, RAYCASTS);
+    
+    world_destroy(world);
+    return 0;
+}
\ No newline at end of file
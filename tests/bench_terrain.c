@@ -0,0 +1,249 @@
+#include "terrain.h"
+#include "chunk.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+// Chunk generation throughput on 1 to MAX_THREADS threads, each thread
+// taking every n-th chunk of a square around the origin. First, the
+// column-run fill is compared on one thread with a per-block reference
+// that writes each block through chunk_set_block, as generation used to.
+#define BENCH_SEED 12345
+#define GRID 24
+#define GRID_CHUNKS (GRID * GRID)
+#define MAX_THREADS 8
+
+// Randomness and tree shape of terrain.c, which the reference has to
+// reproduce block for block
+enum {
+    RANDOM_ORE_CHANCE = 1,
+    RANDOM_ORE_TYPE,
+    RANDOM_TREE
+};
+
+#define TREE_RADIUS 2
+#define DECORATION_SIZE (CHUNK_SIZE + 2 * TREE_RADIUS)
+
+typedef struct {
+    TerrainGenerator* terrain;
+    int first;
+    int stride;
+} BenchThread;
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static int random_percent(int seed, int x, int y, int z, int stream) {
+    uint64_t h = (uint64_t)(uint32_t)seed * 0x9E3779B97F4A7C15ULL;
+    h ^= (uint64_t)(uint32_t)x * 0xBF58476D1CE4E5B9ULL;
+    h ^= (uint64_t)(uint32_t)y * 0x94D049BB133111EBULL;
+    h ^= (uint64_t)(uint32_t)z * 0xD6E8FEB86659FD93ULL;
+    h ^= (uint64_t)(uint32_t)stream * 0xA0761D6478BD642FULL;
+    
+    h ^= h >> 30;
+    h *= 0xBF58476D1CE4E5B9ULL;
+    h ^= h >> 27;
+    h *= 0x94D049BB133111EBULL;
+    h ^= h >> 31;
+    return (int)(h % 100);
+}
+
+static BlockType ore_type(int seed, int x, int y, int z) {
+    int rand_val = random_percent(seed, x, y, z, RANDOM_ORE_TYPE);
+    if (y < 16) {
+        if (rand_val < 30) return BLOCK_DIAMOND_ORE;
+    } else if (y < 32) {
+        if (rand_val < 40) return BLOCK_GOLD_ORE;
+    } else if (y < 64) {
+        if (rand_val < 50) return BLOCK_IRON_ORE;
+    }
+    return BLOCK_COAL_ORE;
+}
+
+static void reference_column(int seed, Chunk* chunk, int x, int z, int height) {
+    int world_x = chunk->x * CHUNK_SIZE + x;
+    int world_z = chunk->z * CHUNK_SIZE + z;
+    
+    chunk_set_block(chunk, x, 0, z, BLOCK_BEDROCK);
+    
+    int stone_height = height - 4;
+    if (stone_height < 1) stone_height = 1;
+    for (int y = 1; y < stone_height; y++) {
+        if (random_percent(seed, world_x, y, world_z, RANDOM_ORE_CHANCE) < 1) {
+            chunk_set_block(chunk, x, y, z, ore_type(seed, world_x, y, world_z));
+        } else {
+            chunk_set_block(chunk, x, y, z, BLOCK_STONE);
+        }
+    }
+    
+    int dirt_height = height - 1;
+    if (dirt_height < stone_height) dirt_height = stone_height;
+    for (int y = stone_height; y < dirt_height; y++) {
+        chunk_set_block(chunk, x, y, z, BLOCK_DIRT);
+    }
+    
+    if (height >= SEA_LEVEL) {
+        chunk_set_block(chunk, x, height, z, height > SEA_LEVEL + 30 ? BLOCK_SNOW : BLOCK_GRASS);
+    } else {
+        if (height > SEA_LEVEL - 3) {
+            for (int y = height - 2; y <= height; y++) {
+                chunk_set_block(chunk, x, y, z, BLOCK_SAND);
+            }
+        } else {
+            chunk_set_block(chunk, x, height, z, BLOCK_DIRT);
+        }
+        for (int y = height + 1; y <= SEA_LEVEL; y++) {
+            chunk_set_block(chunk, x, y, z, BLOCK_WATER);
+        }
+    }
+}
+
+static void reference_tree(Chunk* chunk, int x, int z, int height) {
+    if (x >= 0 && x < CHUNK_SIZE && z >= 0 && z < CHUNK_SIZE) {
+        for (int y = height + 1; y < height + 6; y++) {
+            chunk_set_block(chunk, x, y, z, BLOCK_WOOD);
+        }
+    }
+    
+    for (int dx = -TREE_RADIUS; dx <= TREE_RADIUS; dx++) {
+        for (int dz = -TREE_RADIUS; dz <= TREE_RADIUS; dz++) {
+            if (x + dx < 0 || x + dx >= CHUNK_SIZE || z + dz < 0 || z + dz >= CHUNK_SIZE ||
+                abs(dx) + abs(dz) > 3) {
+                continue;
+            }
+            for (int dy = 4; dy <= 7; dy++) {
+                if (chunk_get_block(chunk, x + dx, height + dy, z + dz) == BLOCK_AIR) {
+                    chunk_set_block(chunk, x + dx, height + dy, z + dz, BLOCK_LEAVES);
+                }
+            }
+        }
+    }
+}
+
+// terrain_generate_chunk one block at a time, into a freshly reset chunk
+static void reference_generate(TerrainGenerator* terrain, Chunk* chunk) {
+    int origin_x = chunk->x * CHUNK_SIZE - TREE_RADIUS;
+    int origin_z = chunk->z * CHUNK_SIZE - TREE_RADIUS;
+    int heights[DECORATION_SIZE * DECORATION_SIZE];
+    terrain_get_heightmap(terrain, origin_x, origin_z, DECORATION_SIZE, DECORATION_SIZE, heights);
+    
+    for (int x = 0; x < CHUNK_SIZE; x++) {
+        for (int z = 0; z < CHUNK_SIZE; z++) {
+            int height = heights[(z + TREE_RADIUS) * DECORATION_SIZE + x + TREE_RADIUS];
+            reference_column(terrain->seed, chunk, x, z, height);
+        }
+    }
+    
+    for (int i = 0; i < DECORATION_SIZE; i++) {
+        for (int j = 0; j < DECORATION_SIZE; j++) {
+            int height = heights[j * DECORATION_SIZE + i];
+            if (height >= SEA_LEVEL && height < CHUNK_HEIGHT - 10 &&
+                random_percent(terrain->seed, origin_x + i, height, origin_z + j,
+                               RANDOM_TREE) < 2) {
+                reference_tree(chunk, i - TREE_RADIUS, j - TREE_RADIUS, height);
+            }
+        }
+    }
+}
+
+static bool same_blocks(Chunk* a, Chunk* b) {
+    for (int sy = 0; sy < CHUNK_SECTION_COUNT; sy++) {
+        uint8_t blocks_a[CHUNK_SECTION_VOLUME];
+        uint8_t blocks_b[CHUNK_SECTION_VOLUME];
+        chunk_read_section(a, sy, blocks_a);
+        chunk_read_section(b, sy, blocks_b);
+        if (memcmp(blocks_a, blocks_b, sizeof(blocks_a)) != 0) return false;
+    }
+    return true;
+}
+
+// Per-chunk time of both fills over the grid, after checking they agree
+static bool compare_fills(TerrainGenerator* terrain) {
+    Chunk* chunk = chunk_create(0, 0);
+    Chunk* reference = chunk_create(0, 0);
+    
+    for (int i = 0; i < GRID_CHUNKS; i += 37) {
+        chunk_reset(chunk, i % GRID - GRID / 2, i / GRID - GRID / 2);
+        chunk_reset(reference, chunk->x, chunk->z);
+        terrain_generate_chunk(terrain, chunk);
+        reference_generate(terrain, reference);
+        if (!same_blocks(chunk, reference)) {
+            fprintf(stderr, "reference fill differs at chunk (%d, %d)\n", chunk->x, chunk->z);
+            return false;
+        }
+    }
+    
+    double start = now_seconds();
+    for (int i = 0; i < GRID_CHUNKS; i++) {
+        chunk_reset(reference, i % GRID - GRID / 2, i / GRID - GRID / 2);
+        reference_generate(terrain, reference);
+    }
+    double per_block = (now_seconds() - start) * 1000.0 / GRID_CHUNKS;
+    
+    start = now_seconds();
+    for (int i = 0; i < GRID_CHUNKS; i++) {
+        chunk_reset(chunk, i % GRID - GRID / 2, i / GRID - GRID / 2);
+        terrain_generate_chunk(terrain, chunk);
+    }
+    double runs = (now_seconds() - start) * 1000.0 / GRID_CHUNKS;
+    
+    printf("per-block fill %.3f ms/chunk, column runs %.3f ms/chunk, %.2fx\n",
+           per_block, runs, per_block / runs);
+    
+    chunk_destroy(chunk);
+    chunk_destroy(reference);
+    return true;
+}
+
+static void* generate_thread(void* arg) {
+    BenchThread* bench = (BenchThread*)arg;
+    Chunk* chunk = chunk_create(0, 0);
+    
+    for (int i = bench->first; i < GRID_CHUNKS; i += bench->stride) {
+        chunk_reset(chunk, i % GRID - GRID / 2, i / GRID - GRID / 2);
+        terrain_generate_chunk(bench->terrain, chunk);
+    }
+    
+    chunk_destroy(chunk);
+    return NULL;
+}
+
+int main(int argc, char** argv) {
+    int max_threads = argc > 1 ? atoi(argv[1]) : MAX_THREADS;
+    if (max_threads < 1 || max_threads > MAX_THREADS) max_threads = MAX_THREADS;
+    
+    blocks_init();
+    TerrainGenerator* terrain = terrain_create(BENCH_SEED);
+    if (!terrain) return 1;
+    if (!compare_fills(terrain)) return 1;
+    
+    double single = 0.0;
+    for (int count = 1; count <= max_threads; count *= 2) {
+        pthread_t threads[MAX_THREADS];
+        BenchThread bench[MAX_THREADS];
+        
+        double start = now_seconds();
+        for (int t = 0; t < count; t++) {
+            bench[t] = (BenchThread){ terrain, t, count };
+            pthread_create(&threads[t], NULL, generate_thread, &bench[t]);
+        }
+        for (int t = 0; t < count; t++) {
+            pthread_join(threads[t], NULL);
+        }
+        double elapsed = now_seconds() - start;
+        if (count == 1) single = elapsed;
+        
+        printf("%d thread%s: %d chunks in %.1f ms, %.3f ms/chunk, %.2fx\n",
+               count, count == 1 ? " " : "s", GRID_CHUNKS, elapsed * 1000.0,
+               elapsed * 1000.0 / GRID_CHUNKS, single / elapsed);
+    }
+    
+    terrain_destroy(terrain);
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,93 @@
+#include "world.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+
+// Chunk lookup throughput of world_find_chunk's hash table against the
+// linear scan of World.chunks it replaced, with squares of 289, 1089 and
+// 4225 chunks loaded (render distances 8, 16 and 32). Built with room for
+// 8192 chunks, past the game's MAX_CHUNKS.
+#define BENCH_SEED 12345
+#define LOOKUPS (1 << 16)
+#define TABLE_PASSES 64
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// world_find_chunk as it was before the table
+static Chunk* scan_find_chunk(World* world, int chunk_x, int chunk_z) {
+    for (int i = 0; i < world->chunk_count; i++) {
+        Chunk* chunk = world->chunks[i];
+        if (chunk && chunk->x == chunk_x && chunk->z == chunk_z) {
+            return chunk;
+        }
+    }
+    return NULL;
+}
+
+static int query_x[LOOKUPS];
+static int query_z[LOOKUPS];
+
+int main(void) {
+    static const int distances[] = { 8, 16, 32 };
+    blocks_init();
+    
+    for (int d = 0; d < 3; d++) {
+        int radius = distances[d];
+        int side = 2 * radius + 1;
+        
+        World* world = world_create(BENCH_SEED);
+        if (!world) return 1;
+        for (int x = -radius; x <= radius; x++) {
+            for (int z = -radius; z <= radius; z++) {
+                world_add_chunk(world, chunk_create(x, z));
+            }
+        }
+        if (world->chunk_count != side * side) {
+            fprintf(stderr, "only %d of %d chunks fit\n", world->chunk_count, side * side);
+            return 1;
+        }
+        
+        // Resident chunks picked at random, as block lookups around the
+        // player would
+        uint32_t state = 1;
+        for (int i = 0; i < LOOKUPS; i++) {
+            state = state * 1664525u + 1013904223u;
+            query_x[i] = (int)((state >> 8) % side) - radius;
+            state = state * 1664525u + 1013904223u;
+            query_z[i] = (int)((state >> 8) % side) - radius;
+        }
+        
+        // Both must find the same chunks, and the sum keeps the loops
+        uintptr_t table_sum = 0;
+        double start = now_seconds();
+        for (int pass = 0; pass < TABLE_PASSES; pass++) {
+            for (int i = 0; i < LOOKUPS; i++) {
+                table_sum += (uintptr_t)world_find_chunk(world, query_x[i], query_z[i]);
+            }
+        }
+        double table = (now_seconds() - start) / ((double)LOOKUPS * TABLE_PASSES);
+        
+        uintptr_t scan_sum = 0;
+        start = now_seconds();
+        for (int i = 0; i < LOOKUPS; i++) {
+            scan_sum += (uintptr_t)scan_find_chunk(world, query_x[i], query_z[i]);
+        }
+        double scan = (now_seconds() - start) / LOOKUPS;
+        
+        if (table_sum != scan_sum * TABLE_PASSES) {
+            fprintf(stderr, "table and scan disagree\n");
+            return 1;
+        }
+        
+        printf("%5d chunks: table %6.1f ns/lookup, scan %8.1f ns/lookup, %6.0fx\n",
+               world->chunk_count, table * 1e9, scan * 1e9, scan / table);
+        world_destroy(world);
+    }
+    
+    return 0;
+}
\ No newline at end of file
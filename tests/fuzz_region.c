@@ -0,0 +1,238 @@
+#include "test.h"
+#include "region.h"
+#include "terrain.h"
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// Region files are read back as whatever is on disk, so any bytes opened as
+// one must load without crashing or reading out of bounds, and saving into
+// it afterwards must still read back. `make fuzz` builds this as a
+// libFuzzer target; as a test it feeds damaged copies of a valid file.
+#define TEST_SEED 12345
+#define TEST_MUTATIONS 400
+
+static TerrainGenerator* terrain;
+static Chunk* chunk;
+static char directory[] = "/tmp/fuzz_region.XXXXXX";
+static char path[sizeof(directory) + 16];
+
+static bool setup(void) {
+    if (terrain) return true;
+    
+    blocks_init();
+    terrain = terrain_create(TEST_SEED);
+    chunk = chunk_create(0, 0);
+    if (!terrain || !chunk || !mkdtemp(directory)) return false;
+    snprintf(path, sizeof(path), "%s/r.0.0.dat", directory);
+    return true;
+}
+
+static bool write_file(const uint8_t* data, size_t size) {
+    FILE* file = fopen(path, "wb");
+    if (!file) return false;
+    bool ok = fwrite(data, 1, size, file) == size;
+    return (fclose(file) == 0) && ok;
+}
+
+// The chunk at (x, z) as saved after round edits
+static void make_chunk(Chunk* out, int x, int z, int round) {
+    chunk_reset(out, x, z);
+    terrain_generate_chunk(terrain, out);
+    for (int i = 0; i < 8 + round * 40; i++) {
+        chunk_set_block(out, (i * 5) % CHUNK_SIZE, 70 + (i + round) % 60, (i * 3 + x) % CHUNK_SIZE,
+                        (BlockType)(1 + (i + z) % (BLOCK_COUNT - 1)));
+    }
+}
+
+static bool same_blocks(Chunk* a, Chunk* b) {
+    for (int x = 0; x < CHUNK_SIZE; x++) {
+        for (int y = 0; y < CHUNK_HEIGHT; y++) {
+            for (int z = 0; z < CHUNK_SIZE; z++) {
+                if (chunk_get_block(a, x, y, z) != chunk_get_block(b, x, y, z)) return false;
+            }
+        }
+    }
+    return true;
+}
+
+// Whether the store reads the chunk at (x, z) back as expected
+static bool reads_back(RegionStore* store, int x, int z, Chunk* expected) {
+    chunk_reset(chunk, x, z);
+    return region_read_chunk(store, chunk, terrain) && same_blocks(chunk, expected);
+}
+
+// Load every chunk of the file, then save one into it, which has to read
+// back both before and after the store is reopened
+static void run_input(const uint8_t* data, size_t size) {
+    if (!write_file(data, size)) return;
+    
+    RegionStore* store = region_store_open(directory);
+    for (int z = 0; z < REGION_SIZE; z++) {
+        for (int x = 0; x < REGION_SIZE; x++) {
+            chunk_reset(chunk, x, z);
+            if (region_read_chunk(store, chunk, terrain)) {
+                CHECK(chunk_get_block(chunk, 0, 0, 0) < BLOCK_COUNT);
+            }
+        }
+    }
+    
+    // Files the store doesn't recognize are left alone
+    Chunk* saved = chunk_create(3, 5);
+    make_chunk(saved, 3, 5, 2);
+    bool written = region_write_chunk(store, saved, terrain) > 0;
+    if (written) CHECK(reads_back(store, 3, 5, saved));
+    region_store_close(store);
+    
+    if (written) {
+        store = region_store_open(directory);
+        CHECK(reads_back(store, 3, 5, saved));
+        region_store_close(store);
+    }
+    
+    chunk_destroy(saved);
+    remove(path);
+}
+
+#ifdef FUZZ_LIBFUZZER
+
+int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+    if (!setup()) abort();
+    run_input(data, size);
+    if (test_failures) abort();
+    return 0;
+}
+
+#else
+
+static uint8_t* read_file(const char* name, size_t* size) {
+    FILE* file = fopen(name, "rb");
+    if (!file) return NULL;
+    
+    fseek(file, 0, SEEK_END);
+    long length = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    uint8_t* data = length >= 0 ? (uint8_t*)malloc((size_t)length + 1) : NULL;
+    if (data && fread(data, 1, (size_t)length, file) != (size_t)length) {
+        free(data);
+        data = NULL;
+    }
+    fclose(file);
+    
+    *size = (size_t)length;
+    return data;
+}
+
+// Byte offset of one slot of the chunk at index, as laid out on disk
+static size_t slot_offset(int index, int slot) {
+    return sizeof(RegionHeader) + (index * REGION_SLOTS + slot) * sizeof(RegionEntry);
+}
+
+// A file holding a few chunks, (1, 1) saved twice so both its slots are in
+// use and the second is live
+static uint8_t* make_region(size_t* size, Chunk* first, Chunk* second) {
+    RegionStore* store = region_store_open(directory);
+    Chunk* other = chunk_create(0, 0);
+    
+    for (int i = 0; i < 6; i++) {
+        make_chunk(other, i * 4, i * 5, i % 3 ? i : 60);
+        CHECK(region_write_chunk(store, other, terrain) > 0);
+    }
+    make_chunk(first, 1, 1, 0);
+    CHECK(region_write_chunk(store, first, terrain) > 0);
+    make_chunk(second, 1, 1, 1);
+    CHECK(region_write_chunk(store, second, terrain) > 0);
+    
+    chunk_destroy(other);
+    region_store_close(store);
+    
+    uint8_t* data = read_file(path, size);
+    remove(path);
+    return data;
+}
+
+int main(int argc, char** argv) {
+    CHECK(setup());
+    if (test_failures) return TEST_RESULT("fuzz_region");
+    
+    // Replay inputs given on the command line, e.g. crashes found by `make fuzz`
+    if (argc > 1) {
+        for (int i = 1; i < argc; i++) {
+            size_t size;
+            uint8_t* data = read_file(argv[i], &size);
+            CHECK(data);
+            if (data) run_input(data, size);
+            free(data);
+        }
+        rmdir(directory);
+        return TEST_RESULT("fuzz_region");
+    }
+    
+    Chunk* first = chunk_create(1, 1);
+    Chunk* second = chunk_create(1, 1);
+    size_t size;
+    uint8_t* valid = make_region(&size, first, second);
+    uint8_t* damaged = valid ? (uint8_t*)malloc(size) : NULL;
+    CHECK(valid && damaged && size > slot_offset(REGION_CHUNKS, 0));
+    if (!damaged) return TEST_RESULT("fuzz_region");
+    
+    int index = 1 + 1 * REGION_SIZE;
+    RegionStore* store;
+    
+    // Intact, the newer record is read
+    CHECK(write_file(valid, size));
+    store = region_store_open(directory);
+    CHECK(reads_back(store, 1, 1, second));
+    region_store_close(store);
+    
+    // A torn write of the live slot falls back on the previous record
+    memcpy(damaged, valid, size);
+    damaged[slot_offset(index, 1) + 2] ^= 0x40;
+    CHECK(write_file(damaged, size));
+    store = region_store_open(directory);
+    CHECK(reads_back(store, 1, 1, first));
+    
+    // and the next save goes to the damaged slot, leaving the good one
+    CHECK(region_write_chunk(store, second, terrain) > 0);
+    region_store_close(store);
+    size_t saved_size;
+    uint8_t* saved = read_file(path, &saved_size);
+    CHECK(saved && saved_size > slot_offset(REGION_CHUNKS, 0) &&
+          memcmp(saved + slot_offset(index, 0), valid + slot_offset(index, 0),
+                 sizeof(RegionEntry)) == 0);
+    free(saved);
+    store = region_store_open(directory);
+    CHECK(reads_back(store, 1, 1, second));
+    region_store_close(store);
+    remove(path);
+    
+    run_input(valid, size);
+    
+    // Flip bytes, mostly in the header and table, and cut the file short
+    uint32_t state = 1;
+    for (int i = 0; i < TEST_MUTATIONS; i++) {
+        memcpy(damaged, valid, size);
+        size_t length = size;
+        
+        for (int flips = 1 + i % 4; flips > 0; flips--) {
+            state = state * 1664525u + 1013904223u;
+            size_t range = (state >> 31) ? slot_offset(REGION_CHUNKS, 0) : size;
+            damaged[(state >> 8) % range] ^= (uint8_t)(1 + (state >> 3) % 255);
+        }
+        if (i % 5 == 0) {
+            state = state * 1664525u + 1013904223u;
+            length = (state >> 8) % size;
+        }
+        
+        run_input(damaged, length);
+    }
+    
+    free(valid);
+    free(damaged);
+    chunk_destroy(first);
+    chunk_destroy(second);
+    rmdir(directory);
+    return TEST_RESULT("fuzz_region");
+}
+
+#endif
\ No newline at end of file
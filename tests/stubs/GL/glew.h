@@ -0,0 +1,109 @@
+#ifndef TEST_STUB_GLEW_H
+#define TEST_STUB_GLEW_H
+
+// Just enough of GLEW for the CPU-side parts of mesh.c to build into the
+// tests. There is no context: every extension reads as missing and GL
+// calls do nothing.
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef unsigned int GLenum;
+typedef unsigned int GLuint;
+typedef int GLint;
+typedef int GLsizei;
+typedef unsigned char GLboolean;
+typedef unsigned int GLbitfield;
+typedef float GLfloat;
+typedef ptrdiff_t GLsizeiptr;
+typedef ptrdiff_t GLintptr;
+typedef uint64_t GLuint64;
+typedef struct __GLsync* GLsync;
+
+#define GL_FALSE 0
+#define GL_TRUE 1
+#define GL_NO_ERROR 0
+#define GL_OUT_OF_MEMORY 0x0505
+#define GL_TRIANGLES 0x0004
+#define GL_UNSIGNED_INT 0x1405
+#define GL_FLOAT 0x1406
+#define GL_ARRAY_BUFFER 0x8892
+#define GL_ELEMENT_ARRAY_BUFFER 0x8893
+#define GL_COPY_READ_BUFFER 0x8F36
+#define GL_COPY_WRITE_BUFFER 0x8F37
+#define GL_DRAW_INDIRECT_BUFFER 0x8F3F
+#define GL_STREAM_DRAW 0x88E0
+#define GL_STATIC_DRAW 0x88E4
+#define GL_DYNAMIC_DRAW 0x88E8
+#define GL_MAP_WRITE_BIT 0x0002
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#define GL_MAP_COHERENT_BIT 0x0080
+#define GL_SYNC_GPU_COMMANDS_COMPLETE 0x9117
+#define GL_SYNC_FLUSH_COMMANDS_BIT 0x00000001
+#define GL_TIMEOUT_EXPIRED 0x911B
+
+#define GLEW_VERSION_4_3 0
+#define GLEW_VERSION_4_4 0
+#define GLEW_ARB_buffer_storage 0
+#define GLEW_ARB_multi_draw_indirect 0
+#define GLEW_ARB_base_instance 0
+
+static inline GLenum glGetError(void) { return GL_NO_ERROR; }
+static inline void glGenBuffers(GLsizei n, GLuint* buffers) { for (GLsizei i = 0; i < n; i++) buffers[i] = 1; }
+static inline void glDeleteBuffers(GLsizei n, const GLuint* buffers) { (void)n; (void)buffers; }
+static inline void glBindBuffer(GLenum target, GLuint buffer) { (void)target; (void)buffer; }
+static inline void glBufferData(GLenum target, GLsizeiptr size, const void* data, GLenum usage) {
+    (void)target; (void)size; (void)data; (void)usage;
+}
+static inline void glBufferSubData(GLenum target, GLintptr offset, GLsizeiptr size, const void* data) {
+    (void)target; (void)offset; (void)size; (void)data;
+}
+static inline void glBufferStorage(GLenum target, GLsizeiptr size, const void* data, GLbitfield flags) {
+    (void)target; (void)size; (void)data; (void)flags;
+}
+static inline void glCopyBufferSubData(GLenum read, GLenum write, GLintptr read_offset,
+                                       GLintptr write_offset, GLsizeiptr size) {
+    (void)read; (void)write; (void)read_offset; (void)write_offset; (void)size;
+}
+static inline void* glMapBufferRange(GLenum target, GLintptr offset, GLsizeiptr length,
+                                     GLbitfield access) {
+    (void)target; (void)offset; (void)length; (void)access;
+    return NULL;
+}
+static inline GLboolean glUnmapBuffer(GLenum target) { (void)target; return GL_TRUE; }
+static inline void glGenVertexArrays(GLsizei n, GLuint* arrays) { for (GLsizei i = 0; i < n; i++) arrays[i] = 1; }
+static inline void glDeleteVertexArrays(GLsizei n, const GLuint* arrays) { (void)n; (void)arrays; }
+static inline void glBindVertexArray(GLuint array) { (void)array; }
+static inline void glEnableVertexAttribArray(GLuint index) { (void)index; }
+static inline void glVertexAttribPointer(GLuint index, GLint size, GLenum type, GLboolean normalized,
+                                         GLsizei stride, const void* pointer) {
+    (void)index; (void)size; (void)type; (void)normalized; (void)stride; (void)pointer;
+}
+static inline void glVertexAttribIPointer(GLuint index, GLint size, GLenum type, GLsizei stride,
+                                          const void* pointer) {
+    (void)index; (void)size; (void)type; (void)stride; (void)pointer;
+}
+static inline void glVertexAttribDivisor(GLuint index, GLuint divisor) { (void)index; (void)divisor; }
+static inline void glVertexAttrib3f(GLuint index, GLfloat x, GLfloat y, GLfloat z) {
+    (void)index; (void)x; (void)y; (void)z;
+}
+static inline GLsync glFenceSync(GLenum condition, GLbitfield flags) {
+    (void)condition; (void)flags;
+    return NULL;
+}
+static inline GLenum glClientWaitSync(GLsync sync, GLbitfield flags, GLuint64 timeout) {
+    (void)sync; (void)flags; (void)timeout;
+    return GL_TIMEOUT_EXPIRED;
+}
+static inline void glDeleteSync(GLsync sync) { (void)sync; }
+static inline void glMultiDrawElementsBaseVertex(GLenum mode, const GLsizei* count, GLenum type,
+                                                 const void* const* indices, GLsizei draw_count,
+                                                 const GLint* base_vertex) {
+    (void)mode; (void)count; (void)type; (void)indices; (void)draw_count; (void)base_vertex;
+}
+static inline void glMultiDrawElementsIndirect(GLenum mode, GLenum type, const void* indirect,
+                                               GLsizei draw_count, GLsizei stride) {
+    (void)mode; (void)type; (void)indirect; (void)draw_count; (void)stride;
+}
+
+#endif
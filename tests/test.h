@@ -0,0 +1,31 @@
+#ifndef TEST_H
+#define TEST_H
+
+#include <stdio.h>
+
+// Minimal checks for the standalone test programs: a failed CHECK reports
+// itself and the program exits nonzero at TEST_RESULT
+static int test_failures = 0;
+
+#define CHECK(cond) do { \
+    if (!(cond)) { \
+        fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+        test_failures++; \
+    } \
+} while (0)
+
+#define CHECK_EQ_U64(a, b) do { \
+    unsigned long long check_a = (unsigned long long)(a); \
+    unsigned long long check_b = (unsigned long long)(b); \
+    if (check_a != check_b) { \
+        fprintf(stderr, "%s:%d: check failed: %s == %s (%016llx vs %016llx)\n", \
+                __FILE__, __LINE__, #a, #b, check_a, check_b); \
+        test_failures++; \
+    } \
+} while (0)
+
+#define TEST_RESULT(name) \
+    (test_failures ? (fprintf(stderr, "%s: %d failed\n", name, test_failures), 1) \
+                   : (printf("%s: ok\n", name), 0))
+
+#endif
\ No newline at end of file
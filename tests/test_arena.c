@@ -0,0 +1,180 @@
+#include "test.h"
+#include "arena.h"
+#include <stdlib.h>
+#include <string.h>
+
+// The arena hands out non-overlapping ranges, keeps its free list sorted
+// and merged, and ends up as one free range once everything is freed
+#define STRESS_CAPACITY 4096
+#define STRESS_SLOTS 256
+#define STRESS_STEPS 200000
+
+// arena.c is built with realloc renamed to this
+static bool realloc_fails = false;
+
+void* test_realloc(void* pointer, size_t size) {
+    return realloc_fails ? NULL : realloc(pointer, size);
+}
+
+// Free ranges sorted by offset, none empty or touching the next, inside
+// the capacity, and adding up with used to the capacity
+static bool free_list_valid(const Arena* arena) {
+    uint64_t free_total = 0;
+    for (int i = 0; i < arena->free_count; i++) {
+        const ArenaRange* range = &arena->free[i];
+        if (range->size == 0) return false;
+        if ((uint64_t)range->offset + range->size > arena->capacity) return false;
+        if (i > 0 && arena->free[i - 1].offset + arena->free[i - 1].size >= range->offset) {
+            return false;
+        }
+        free_total += range->size;
+    }
+    return free_total + arena->used == arena->capacity;
+}
+
+static void check_basics(void) {
+    Arena arena;
+    uint32_t a, b, c, d;
+    CHECK(arena_init(&arena, 100));
+    
+    CHECK(arena_alloc(&arena, 10, &a) && a == 0);
+    CHECK(arena_alloc(&arena, 20, &b) && b == 10);
+    CHECK(arena_alloc(&arena, 30, &c) && c == 30);
+    CHECK(!arena_alloc(&arena, 41, &d));
+    CHECK(!arena_alloc(&arena, 0, &d));
+    CHECK(arena.used == 60 && arena.allocations == 3);
+    
+    // Best fit picks the 10-unit hole over the 40 at the end
+    arena_free(&arena, a, 10);
+    CHECK(arena_alloc(&arena, 8, &d) && d == 0);
+    arena_free(&arena, d, 8);
+    
+    // Freeing the middle joins both neighbors into one range
+    arena_free(&arena, c, 30);
+    CHECK(arena.free_count == 2);
+    arena_free(&arena, b, 20);
+    CHECK(arena.free_count == 1 && arena.free[0].offset == 0 && arena.free[0].size == 100);
+    CHECK(arena.used == 0 && arena.allocations == 0);
+    
+    // An exact fit removes the range
+    CHECK(arena_alloc(&arena, 100, &a) && a == 0);
+    CHECK(arena.free_count == 0);
+    CHECK(!arena_alloc(&arena, 1, &b));
+    
+    // Growing a full arena adds a range at the old end, growing one that
+    // ends in free space extends it
+    CHECK(arena_grow(&arena, 150));
+    CHECK(arena.free_count == 1 && arena.free[0].offset == 100 && arena.free[0].size == 50);
+    CHECK(arena_grow(&arena, 200));
+    CHECK(arena.free_count == 1 && arena.free[0].size == 100);
+    CHECK(arena_grow(&arena, 120) && arena.capacity == 200);
+    CHECK(arena_alloc(&arena, 100, &b) && b == 100);
+    
+    ArenaStats stats;
+    arena_free(&arena, a, 100);
+    arena_free(&arena, b, 100);
+    CHECK(arena_alloc(&arena, 50, &a));
+    CHECK(arena_alloc(&arena, 50, &b));
+    CHECK(arena_alloc(&arena, 50, &c));
+    CHECK(arena_alloc(&arena, 50, &d));
+    arena_free(&arena, a, 50);
+    arena_free(&arena, c, 50);
+    arena_get_stats(&arena, &stats);
+    CHECK(stats.capacity == 200 && stats.used == 100 && stats.allocations == 2);
+    CHECK(stats.free_ranges == 2 && stats.largest_free == 50);
+    CHECK(stats.fragmentation > 0.49f && stats.fragmentation < 0.51f);
+    
+    arena_destroy(&arena);
+}
+
+// Random allocations and frees against a map of who owns each unit
+static void check_stress(void) {
+    static uint8_t owner[STRESS_CAPACITY];
+    uint32_t offsets[STRESS_SLOTS];
+    uint32_t sizes[STRESS_SLOTS];
+    memset(owner, 0, sizeof(owner));
+    memset(sizes, 0, sizeof(sizes));
+    
+    Arena arena;
+    CHECK(arena_init(&arena, STRESS_CAPACITY / 2));
+    
+    uint32_t state = 3;
+    int failures = 0;
+    for (int step = 0; step < STRESS_STEPS && !failures; step++) {
+        state = state * 1664525u + 1013904223u;
+        int slot = (state >> 8) % STRESS_SLOTS;
+        
+        if (sizes[slot]) {
+            for (uint32_t i = 0; i < sizes[slot]; i++) owner[offsets[slot] + i] = 0;
+            arena_free(&arena, offsets[slot], sizes[slot]);
+            sizes[slot] = 0;
+        } else {
+            uint32_t size = 1 + (state >> 20) % 64;
+            uint32_t offset;
+            if (!arena_alloc(&arena, size, &offset)) {
+                // Running out is fine until the arena has grown
+                if (arena.capacity < STRESS_CAPACITY) CHECK(arena_grow(&arena, STRESS_CAPACITY));
+                continue;
+            }
+            if (offset + size > arena.capacity) failures++;
+            for (uint32_t i = 0; i < size && !failures; i++) {
+                if (owner[offset + i]) failures++;
+                owner[offset + i] = 1;
+            }
+            offsets[slot] = offset;
+            sizes[slot] = size;
+        }
+        
+        if (step % 97 == 0 && !free_list_valid(&arena)) failures++;
+    }
+    CHECK(failures == 0);
+    CHECK(free_list_valid(&arena));
+    
+    for (int slot = 0; slot < STRESS_SLOTS; slot++) {
+        if (sizes[slot]) arena_free(&arena, offsets[slot], sizes[slot]);
+    }
+    CHECK(arena.used == 0 && arena.allocations == 0);
+    CHECK(arena.free_count == 1 && arena.free[0].size == arena.capacity);
+    
+    arena_destroy(&arena);
+}
+
+// With the free list unable to grow, allocations that would need a bigger
+// list fail without changing anything, and frees never lose a range
+static void check_out_of_memory(void) {
+    Arena arena;
+    uint32_t offset;
+    CHECK(arena_init(&arena, 1000));
+    
+    int count = 0;
+    while (arena.allocations + 2 <= arena.free_capacity) {
+        CHECK(arena_alloc(&arena, 1, &offset) && offset == (uint32_t)count);
+        count++;
+    }
+    realloc_fails = true;
+    CHECK(!arena_alloc(&arena, 1, &offset));
+    CHECK(arena.used == (uint32_t)count && arena.allocations == count);
+    CHECK(free_list_valid(&arena));
+    realloc_fails = false;
+    
+    // Freeing every other unit leaves as many free ranges as allocations,
+    // which used to outgrow the list
+    for (; count < 130; count++) CHECK(arena_alloc(&arena, 1, &offset));
+    realloc_fails = true;
+    for (int i = 1; i < count; i += 2) arena_free(&arena, (uint32_t)i, 1);
+    CHECK(arena.free_count == count / 2);
+    CHECK(free_list_valid(&arena));
+    for (int i = 0; i < count; i += 2) arena_free(&arena, (uint32_t)i, 1);
+    CHECK(arena.used == 0 && arena.allocations == 0);
+    CHECK(arena.free_count == 1 && arena.free[0].size == arena.capacity);
+    realloc_fails = false;
+    
+    arena_destroy(&arena);
+}
+
+int main(void) {
+    check_basics();
+    check_stress();
+    check_out_of_memory();
+    return TEST_RESULT("arena");
+}
\ No newline at end of file
@@ -0,0 +1,135 @@
+#include "test.h"
+#include "codec.h"
+#include "terrain.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Saved chunks must decode to the blocks they were encoded from, as edit
+// records on top of terrain or as whole column runs, and damaged records
+// must be rejected or decoded without reading out of bounds
+#define TEST_SEED 12345
+
+static TerrainGenerator* terrain;
+static CodecScratch* scratch;
+static uint8_t record[CODEC_MAX_SIZE];
+static uint8_t damaged[CODEC_MAX_SIZE];
+
+static bool same_blocks(Chunk* a, Chunk* b) {
+    for (int x = 0; x < CHUNK_SIZE; x++) {
+        for (int y = 0; y < CHUNK_HEIGHT; y++) {
+            for (int z = 0; z < CHUNK_SIZE; z++) {
+                if (chunk_get_block(a, x, y, z) != chunk_get_block(b, x, y, z)) return false;
+            }
+        }
+    }
+    return true;
+}
+
+// Encodes the chunk, checks the record type and that it decodes back,
+// and returns the record size
+static size_t check_round_trip(Chunk* chunk, TerrainGenerator* gen, CodecRecordType type) {
+    size_t length = codec_encode_chunk(chunk, gen, record, scratch);
+    CHECK(length >= CODEC_HEADER_SIZE && length <= CODEC_MAX_SIZE);
+    CHECK(record[0] == CHUNK_CODEC_VERSION);
+    CHECK(record[1] == type);
+    
+    Chunk* decoded = chunk_create(chunk->x, chunk->z);
+    CHECK(codec_decode_chunk(decoded, gen, record, length, scratch));
+    CHECK(same_blocks(chunk, decoded));
+    chunk_destroy(decoded);
+    return length;
+}
+
+// Every truncation of a record must fail, single byte changes must not
+// crash and, for run records, may only decode to valid blocks
+static void check_damage(size_t length) {
+    Chunk* decoded = chunk_create(0, 0);
+    
+    for (size_t cut = 0; cut < length; cut += (cut < 64 ? 1 : 37)) {
+        chunk_reset(decoded, 0, 0);
+        CHECK(!codec_decode_chunk(decoded, terrain, record, cut, scratch));
+    }
+    
+    uint32_t state = 7;
+    for (int i = 0; i < 200; i++) {
+        state = state * 1664525u + 1013904223u;
+        memcpy(damaged, record, length);
+        damaged[(state >> 8) % length] ^= (uint8_t)(1 + (state >> 24) % 255);
+        
+        chunk_reset(decoded, 0, 0);
+        if (codec_decode_chunk(decoded, terrain, damaged, length, scratch)) {
+            CHECK(chunk_get_block(decoded, 0, 0, 0) < BLOCK_COUNT);
+        }
+    }
+    
+    memcpy(damaged, record, length);
+    damaged[0] = CHUNK_CODEC_VERSION + 1;
+    chunk_reset(decoded, 0, 0);
+    CHECK(!codec_decode_chunk(decoded, terrain, damaged, length, scratch));
+    
+    chunk_destroy(decoded);
+}
+
+int main(void) {
+    blocks_init();
+    terrain = terrain_create(TEST_SEED);
+    scratch = codec_scratch_create();
+    CHECK(terrain && scratch);
+    if (!terrain || !scratch) return TEST_RESULT("codec");
+    
+    Chunk* chunk = chunk_create(-3, 2);
+    terrain_generate_chunk(terrain, chunk);
+    
+    // Untouched terrain is an empty edit list, and whole runs without a
+    // generator to diff against
+    size_t length = check_round_trip(chunk, terrain, CODEC_RECORD_EDITS);
+    CHECK(length == CODEC_HEADER_SIZE + sizeof(uint16_t));
+    check_round_trip(chunk, NULL, CODEC_RECORD_RUNS);
+    
+    // Edits are only replayed on terrain, so need a generator to decode
+    for (int i = 0; i < 40; i++) {
+        chunk_set_block(chunk, i % CHUNK_SIZE, 60 + i, (i * 7) % CHUNK_SIZE, BLOCK_BRICK);
+    }
+    chunk_set_block(chunk, 3, 0, 3, BLOCK_AIR);
+    length = check_round_trip(chunk, terrain, CODEC_RECORD_EDITS);
+    Chunk* decoded = chunk_create(chunk->x, chunk->z);
+    CHECK(!codec_decode_chunk(decoded, NULL, record, length, scratch));
+    chunk_destroy(decoded);
+    check_damage(length);
+    
+    // Past CODEC_MAX_EDITS the chunk is stored whole
+    for (int y = 100; y < 110; y++) {
+        for (int x = 0; x < CHUNK_SIZE; x++) {
+            for (int z = 0; z < CHUNK_SIZE; z++) {
+                chunk_set_block(chunk, x, y, z, (x + z) % 2 ? BLOCK_GLASS : BLOCK_PLANKS);
+            }
+        }
+    }
+    length = check_round_trip(chunk, terrain, CODEC_RECORD_RUNS);
+    check_damage(length);
+    
+    // Worst case for column runs: every block differs from the one below
+    Chunk* noise = chunk_create(9, -9);
+    uint32_t state = 1;
+    for (int x = 0; x < CHUNK_SIZE; x++) {
+        for (int y = 0; y < CHUNK_HEIGHT; y++) {
+            for (int z = 0; z < CHUNK_SIZE; z++) {
+                state = state * 1664525u + 1013904223u;
+                chunk_set_block(noise, x, y, z, (BlockType)((state >> 16) % BLOCK_COUNT));
+            }
+        }
+    }
+    length = check_round_trip(noise, terrain, CODEC_RECORD_RUNS);
+    CHECK(length <= CODEC_MAX_SIZE);
+    
+    // An empty chunk
+    Chunk* empty = chunk_create(0, 0);
+    check_round_trip(empty, NULL, CODEC_RECORD_RUNS);
+    
+    chunk_destroy(chunk);
+    chunk_destroy(noise);
+    chunk_destroy(empty);
+    codec_scratch_destroy(scratch);
+    terrain_destroy(terrain);
+    return TEST_RESULT("codec");
+}
\ No newline at end of file
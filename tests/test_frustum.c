@@ -0,0 +1,121 @@
+#include "test.h"
+#include "frustum.h"
+#include "camera.h"
+#include "config.h"
+#include <stdlib.h>
+#include <math.h>
+
+// frustum_cull_boxes must agree with the one-box frustum_test_box, and
+// culling must be conservative: a box with any point inside the view
+// volume is never culled
+#define BOX_COUNT 2001
+#define SAMPLES 4
+
+static uint32_t random_state = 1;
+
+static float random_float(float min, float max) {
+    random_state = random_state * 1664525u + 1013904223u;
+    return min + (max - min) * (float)(random_state >> 8) / (float)(1 << 24);
+}
+
+// Inside in clip space, -w <= x, y, z <= w
+static bool point_in_view(const float* clip, const float* p) {
+    float out[4];
+    for (int row = 0; row < 4; row++) {
+        out[row] = clip[0 * 4 + row] * p[0] + clip[1 * 4 + row] * p[1] +
+                   clip[2 * 4 + row] * p[2] + clip[3 * 4 + row];
+    }
+    for (int i = 0; i < 3; i++) {
+        if (out[i] < -out[3] || out[i] > out[3]) return false;
+    }
+    return true;
+}
+
+static void check_view(float* eye, float* center) {
+    float up[3] = { 0.0f, 1.0f, 0.0f };
+    float projection[16], view[16], clip[16];
+    mat4_perspective(projection, FOV, 16.0f / 9.0f, NEAR_PLANE, FAR_PLANE);
+    mat4_look_at(view, eye, center, up);
+    mat4_multiply(clip, view, projection);
+    
+    Frustum frustum;
+    frustum_from_matrix(&frustum, clip);
+    
+    static FrustumBoxes boxes[(BOX_COUNT + FRUSTUM_LANES - 1) / FRUSTUM_LANES];
+    static float mins[BOX_COUNT][3], maxs[BOX_COUNT][3];
+    static uint8_t visible[BOX_COUNT];
+    
+    for (int i = 0; i < BOX_COUNT; i++) {
+        for (int a = 0; a < 3; a++) {
+            float size = random_float(0.5f, 40.0f);
+            mins[i][a] = eye[a] + random_float(-FAR_PLANE * 1.2f, FAR_PLANE * 1.2f);
+            maxs[i][a] = mins[i][a] + size;
+        }
+        frustum_set_box(boxes, i, mins[i], maxs[i]);
+    }
+    
+    int count = frustum_cull_boxes(&frustum, boxes, BOX_COUNT, visible);
+    
+    int expected_count = 0;
+    int agree = 0, conservative = 0;
+    for (int i = 0; i < BOX_COUNT; i++) {
+        expected_count += visible[i];
+        agree += visible[i] == frustum_test_box(&frustum, mins[i], maxs[i]);
+        
+        // Corners, the center and a few random points
+        bool inside = false;
+        for (int corner = 0; corner < 8 + 1 + SAMPLES && !inside; corner++) {
+            float p[3];
+            for (int a = 0; a < 3; a++) {
+                if (corner < 8) p[a] = (corner >> a) & 1 ? maxs[i][a] : mins[i][a];
+                else if (corner == 8) p[a] = (mins[i][a] + maxs[i][a]) * 0.5f;
+                else p[a] = random_float(mins[i][a], maxs[i][a]);
+            }
+            inside = point_in_view(clip, p);
+        }
+        conservative += !inside || visible[i];
+    }
+    
+    CHECK(count == expected_count);
+    CHECK(agree == BOX_COUNT);
+    CHECK(conservative == BOX_COUNT);
+    
+    // A box around the eye is always visible, one straight behind it or
+    // past the far plane never is
+    float forward[3], length = 0.0f;
+    for (int a = 0; a < 3; a++) {
+        forward[a] = center[a] - eye[a];
+        length += forward[a] * forward[a];
+    }
+    length = sqrtf(length);
+    
+    float around_min[3], around_max[3], behind_min[3], behind_max[3], far_min[3], far_max[3];
+    for (int a = 0; a < 3; a++) {
+        float f = forward[a] / length;
+        around_min[a] = eye[a] - 1.0f;
+        around_max[a] = eye[a] + 1.0f;
+        behind_min[a] = eye[a] - f * 50.0f - 1.0f;
+        behind_max[a] = eye[a] - f * 50.0f + 1.0f;
+        far_min[a] = eye[a] + f * FAR_PLANE * 1.5f - 1.0f;
+        far_max[a] = eye[a] + f * FAR_PLANE * 1.5f + 1.0f;
+    }
+    CHECK(frustum_test_box(&frustum, around_min, around_max));
+    CHECK(!frustum_test_box(&frustum, behind_min, behind_max));
+    CHECK(!frustum_test_box(&frustum, far_min, far_max));
+}
+
+int main(void) {
+    float eye_level[3] = { 8.0f, 80.0f, 8.0f };
+    float ahead[3] = { 8.0f, 80.0f, -100.0f };
+    check_view(eye_level, ahead);
+    
+    float diagonal[3] = { -1000.0f, 70.0f, 2300.0f };
+    float down[3] = { -950.0f, 20.0f, 2340.0f };
+    check_view(diagonal, down);
+    
+    float high[3] = { 0.5f, 250.0f, 0.5f };
+    float steep[3] = { 3.0f, 100.0f, 1.0f };
+    check_view(high, steep);
+    
+    return TEST_RESULT("frustum");
+}
\ No newline at end of file
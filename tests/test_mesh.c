@@ -0,0 +1,276 @@
+#include "test.h"
+#include "mesh.h"
+#include "terrain.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Naive meshing must emit exactly the faces a block-by-block check finds
+// visible, and greedy meshing, which merges faces, must cover the same
+// ones, each once and with the same block. Both meshes are rasterized
+// back into unit faces and compared with the check.
+#define TEST_SEED 12345
+#define CHUNK_VOLUME (CHUNK_SIZE * CHUNK_HEIGHT * CHUNK_SIZE)
+#define FACE_CELL(face, x, y, z) \
+    ((((face) * CHUNK_SIZE + (x)) * CHUNK_HEIGHT + (y)) * CHUNK_SIZE + (z))
+
+// The block axis along each face's normal, and whether the quad lies on
+// the far side of the block (top, east and south faces)
+static const int face_normal_axis[6] = { 1, 1, 0, 0, 2, 2 };
+
+// Unit faces covered by a mesh, holding block + 1 or 0. Returns false
+// when quads overlap or leave the chunk.
+static bool rasterize(const MeshData* data, uint8_t* cells) {
+    memset(cells, 0, 6 * CHUNK_VOLUME);
+    
+    for (int v = 0; v < data->vertex_count; v += 4) {
+        int min[3] = { 1 << 30, 1 << 30, 1 << 30 };
+        int max[3] = { -1, -1, -1 };
+        int face = (data->vertices[v].position >> 19) & 7;
+        uint32_t block = data->vertices[v].block;
+        
+        for (int i = 0; i < 4; i++) {
+            uint32_t position = data->vertices[v + i].position;
+            int p[3] = { position & 0x1F, MESH_POSITION_Y(position), (position >> 14) & 0x1F };
+            if ((int)((position >> 19) & 7) != face || data->vertices[v + i].block != block) {
+                return false;
+            }
+            for (int a = 0; a < 3; a++) {
+                if (p[a] < min[a]) min[a] = p[a];
+                if (p[a] > max[a]) max[a] = p[a];
+            }
+        }
+        
+        int d = face_normal_axis[face];
+        if (min[d] != max[d]) return false;
+        if (face % 2 == 0) min[d]--;
+        max[d] = min[d] + 1;
+        if (min[0] < 0 || min[1] < 0 || min[2] < 0) return false;
+        if (max[0] > CHUNK_SIZE || max[1] > CHUNK_HEIGHT || max[2] > CHUNK_SIZE) return false;
+        
+        for (int x = min[0]; x < max[0]; x++) {
+            for (int y = min[1]; y < max[1]; y++) {
+                for (int z = min[2]; z < max[2]; z++) {
+                    uint8_t* cell = &cells[FACE_CELL(face, x, y, z)];
+                    if (*cell) return false;
+                    *cell = (uint8_t)(block + 1);
+                }
+            }
+        }
+    }
+    
+    return true;
+}
+
+// Top, bottom, east, west, south and north, in face id order
+static const int face_offsets[6][3] = {
+    { 0, 1, 0 }, { 0, -1, 0 }, { 1, 0, 0 }, { -1, 0, 0 }, { 0, 0, 1 }, { 0, 0, -1 }
+};
+
+// The block at local (x, y, z), which may lie in a linked neighbor. Air
+// above and below the chunk and where no generated neighbor is linked.
+static BlockType reference_block(Chunk* chunk, int x, int y, int z) {
+    if (y < 0 || y >= CHUNK_HEIGHT) return BLOCK_AIR;
+    
+    if (x < 0) {
+        chunk = chunk->west;
+        x += CHUNK_SIZE;
+    } else if (x >= CHUNK_SIZE) {
+        chunk = chunk->east;
+        x -= CHUNK_SIZE;
+    } else if (z < 0) {
+        chunk = chunk->north;
+        z += CHUNK_SIZE;
+    } else if (z >= CHUNK_SIZE) {
+        chunk = chunk->south;
+        z -= CHUNK_SIZE;
+    }
+    
+    if (!chunk || !chunk->is_generated) return BLOCK_AIR;
+    return chunk_get_block(chunk, x, y, z);
+}
+
+// Unit faces that should be visible, in rasterize's form: a face of a
+// non-air block shows unless the block next to it is opaque
+static void reference_faces(Chunk* chunk, uint8_t* cells) {
+    memset(cells, 0, 6 * CHUNK_VOLUME);
+    
+    for (int x = 0; x < CHUNK_SIZE; x++) {
+        for (int y = 0; y < CHUNK_HEIGHT; y++) {
+            for (int z = 0; z < CHUNK_SIZE; z++) {
+                BlockType block = chunk_get_block(chunk, x, y, z);
+                if (block == BLOCK_AIR) continue;
+                
+                for (int face = 0; face < 6; face++) {
+                    const int* offset = face_offsets[face];
+                    BlockType next = reference_block(chunk, x + offset[0], y + offset[1],
+                                                     z + offset[2]);
+                    if (next == BLOCK_AIR || block_is_transparent(next)) {
+                        cells[FACE_CELL(face, x, y, z)] = (uint8_t)(block + 1);
+                    }
+                }
+            }
+        }
+    }
+}
+
+// Both meshes sorted by section must also keep each quad in the section
+// of its lowest vertex
+static bool sections_consistent(const MeshData* data) {
+    int quads = 0;
+    for (int s = 0; s < CHUNK_SECTION_COUNT; s++) {
+        const MeshSection* section = &data->sections[s];
+        if (section->first_quad != quads) return false;
+        
+        for (int q = section->first_quad; q < section->first_quad + section->quad_count; q++) {
+            int low = CHUNK_HEIGHT;
+            for (int i = 0; i < 4; i++) {
+                int y = MESH_POSITION_Y(data->vertices[q * 4 + i].position);
+                if (y < low) low = y;
+            }
+            if (low / CHUNK_SECTION_HEIGHT != s) return false;
+        }
+        quads += section->quad_count;
+    }
+    return quads * 4 == data->vertex_count;
+}
+
+// Quad counts are pinned as well, so a change in which faces are emitted
+// or how far greedy merging gets shows up as a failure
+static void check_equivalent(Chunk* chunk, const char* name,
+                             int naive_quads, int greedy_quads) {
+    static uint8_t naive_cells[6 * CHUNK_VOLUME];
+    static uint8_t greedy_cells[6 * CHUNK_VOLUME];
+    static uint8_t reference_cells[6 * CHUNK_VOLUME];
+    MeshData naive, greedy;
+    
+    CHECK(mesh_generate(chunk, MESH_MODE_NAIVE, &naive));
+    CHECK(mesh_generate(chunk, MESH_MODE_GREEDY, &greedy));
+    
+    CHECK(rasterize(&naive, naive_cells));
+    CHECK(rasterize(&greedy, greedy_cells));
+    reference_faces(chunk, reference_cells);
+    CHECK(memcmp(naive_cells, reference_cells, sizeof(naive_cells)) == 0);
+    CHECK(memcmp(naive_cells, greedy_cells, sizeof(naive_cells)) == 0);
+    CHECK(greedy.vertex_count <= naive.vertex_count);
+    CHECK(sections_consistent(&naive));
+    CHECK(sections_consistent(&greedy));
+    
+    CHECK(naive.vertex_count == naive_quads * 4);
+    CHECK(greedy.vertex_count == greedy_quads * 4);
+    if (naive.vertex_count != naive_quads * 4 || greedy.vertex_count != greedy_quads * 4) {
+        fprintf(stderr, "  %s: %d naive quads, %d greedy, expected %d and %d\n", name,
+                naive.vertex_count / 4, greedy.vertex_count / 4, naive_quads, greedy_quads);
+    }
+    
+    mesh_data_free(&naive);
+    mesh_data_free(&greedy);
+}
+
+static uint32_t random_state = 1;
+
+static uint32_t next_random(void) {
+    random_state = random_state * 1664525u + 1013904223u;
+    return random_state >> 8;
+}
+
+int main(void) {
+    blocks_init();
+    TerrainGenerator* terrain = terrain_create(TEST_SEED);
+    
+    // Generated terrain with its four neighbors linked, so border faces
+    // depend on the neighboring chunks
+    Chunk* grid[3][3];
+    for (int x = 0; x < 3; x++) {
+        for (int z = 0; z < 3; z++) {
+            grid[x][z] = chunk_create(x - 1, z - 1);
+            terrain_generate_chunk(terrain, grid[x][z]);
+            grid[x][z]->is_generated = true;
+        }
+    }
+    Chunk* center = grid[1][1];
+    center->west = grid[0][1];
+    center->east = grid[2][1];
+    center->north = grid[1][0];
+    center->south = grid[1][2];
+    check_equivalent(center, "terrain", 35254, 2061);
+    
+    // Carve a cave through it and put glass and water inside
+    for (int x = 2; x < 14; x++) {
+        for (int y = 30; y < 60; y++) {
+            for (int z = 3; z < 12; z++) {
+                BlockType type = (y < 34) ? BLOCK_WATER : (x == 7 ? BLOCK_GLASS : BLOCK_AIR);
+                chunk_set_block(center, x, y, z, type);
+            }
+        }
+    }
+    check_equivalent(center, "cave", 28083, 1651);
+    
+    // Scattered opaque and see-through blocks around y = 64 and 128, where
+    // column masks cross from one 64-bit word to the next, on both sides
+    // of every chunk border
+    static const int word_edges[] = { 64, 128 };
+    for (int e = 0; e < 2; e++) {
+        for (int y = word_edges[e] - 3; y < word_edges[e] + 3; y++) {
+            for (int i = 0; i < CHUNK_SIZE; i++) {
+                for (int j = 0; j < CHUNK_SIZE; j++) {
+                    int r = (i * 7 + j * 13 + y * 5) % 11;
+                    BlockType type = r < 4 ? BLOCK_STONE : (r < 6 ? BLOCK_GLASS : BLOCK_AIR);
+                    chunk_set_block(center, i, y, j, type);
+                }
+                // A different pattern on each side, so swapped sides show
+                BlockType side[4];
+                for (int k = 0; k < 4; k++) {
+                    int r = (i * (3 + k) + y + k) % 4;
+                    side[k] = r == 0 ? BLOCK_STONE : (r == 1 ? BLOCK_LEAVES : BLOCK_AIR);
+                }
+                chunk_set_block(grid[0][1], CHUNK_SIZE - 1, y, i, side[0]);
+                chunk_set_block(grid[2][1], 0, y, i, side[1]);
+                chunk_set_block(grid[1][0], i, y, CHUNK_SIZE - 1, side[2]);
+                chunk_set_block(grid[1][2], i, y, 0, side[3]);
+            }
+        }
+    }
+    check_equivalent(center, "words", 29476, 7252);
+    
+    // Noise of every block type, mostly air, and no neighbors
+    static const BlockType palette[] = {
+        BLOCK_STONE, BLOCK_DIRT, BLOCK_GRASS, BLOCK_WATER, BLOCK_GLASS, BLOCK_LEAVES,
+        BLOCK_SAND, BLOCK_ICE, BLOCK_LAVA, BLOCK_WOOD
+    };
+    Chunk* noise = chunk_create(5, 5);
+    for (int x = 0; x < CHUNK_SIZE; x++) {
+        for (int y = 0; y < 96; y++) {
+            for (int z = 0; z < CHUNK_SIZE; z++) {
+                uint32_t r = next_random();
+                if (r % 100 < 45) {
+                    chunk_set_block(noise, x, y, z, palette[(r / 100) % 10]);
+                }
+            }
+        }
+    }
+    noise->is_generated = true;
+    check_equivalent(noise, "noise", 52284, 49002);
+    
+    // Large flat layers, the case greedy merging is for
+    Chunk* layers = chunk_create(-7, 3);
+    for (int x = 0; x < CHUNK_SIZE; x++) {
+        for (int z = 0; z < CHUNK_SIZE; z++) {
+            for (int y = 0; y < 40; y++) {
+                chunk_set_block(layers, x, y, z, y < 20 ? BLOCK_STONE : BLOCK_DIRT);
+            }
+            if ((x + z) % 5 == 0) chunk_set_block(layers, x, 40, z, BLOCK_GRASS);
+        }
+    }
+    layers->is_generated = true;
+    check_equivalent(layers, "layers", 3280, 329);
+    
+    for (int x = 0; x < 3; x++) {
+        for (int z = 0; z < 3; z++) {
+            chunk_destroy(grid[x][z]);
+        }
+    }
+    chunk_destroy(noise);
+    chunk_destroy(layers);
+    terrain_destroy(terrain);
+    return TEST_RESULT("mesh");
+}
\ No newline at end of file
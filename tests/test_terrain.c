@@ -0,0 +1,95 @@
+#include "test.h"
+#include "terrain.h"
+#include "chunk.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <pthread.h>
+
+// Generated terrain must be a pure function of (seed, chunk x, chunk z):
+// the same blocks whatever order the chunks are generated in and on
+// whichever thread. The golden hash pins the output itself, so update it
+// together with CHUNK_CODEC_VERSION when terrain generation changes.
+#define TEST_SEED 12345
+#define GRID 16
+#define GRID_CHUNKS (GRID * GRID)
+#define GOLDEN_HASH 0x00934BC453B77311ULL
+#define THREADS 4
+
+static TerrainGenerator* terrain;
+static uint64_t chunk_hashes[GRID_CHUNKS];
+
+// FNV-1a over every block of the chunk in x, z, y order
+static uint64_t hash_chunk(Chunk* chunk) {
+    uint64_t h = 0xCBF29CE484222325ULL;
+    
+    for (int x = 0; x < CHUNK_SIZE; x++) {
+        for (int z = 0; z < CHUNK_SIZE; z++) {
+            for (int y = 0; y < CHUNK_HEIGHT; y++) {
+                h ^= (uint8_t)chunk_get_block(chunk, x, y, z);
+                h *= 0x100000001B3ULL;
+            }
+        }
+    }
+    
+    return h;
+}
+
+// Chunks of the grid are centered on the origin, so half have negative
+// coordinates
+static uint64_t generate_and_hash(int index) {
+    Chunk* chunk = chunk_create(index % GRID - GRID / 2, index / GRID - GRID / 2);
+    terrain_generate_chunk(terrain, chunk);
+    uint64_t h = hash_chunk(chunk);
+    chunk_destroy(chunk);
+    return h;
+}
+
+static uint64_t combine_hashes(void) {
+    uint64_t h = 0xCBF29CE484222325ULL;
+    for (int i = 0; i < GRID_CHUNKS; i++) {
+        h ^= chunk_hashes[i];
+        h *= 0x100000001B3ULL;
+    }
+    return h;
+}
+
+static void* generate_thread(void* arg) {
+    int first = (int)(intptr_t)arg;
+    for (int i = first; i < GRID_CHUNKS; i += THREADS) {
+        chunk_hashes[i] = generate_and_hash(i);
+    }
+    return NULL;
+}
+
+int main(void) {
+    blocks_init();
+    terrain = terrain_create(TEST_SEED);
+    CHECK(terrain != NULL);
+    if (!terrain) return TEST_RESULT("terrain");
+    
+    for (int i = 0; i < GRID_CHUNKS; i++) {
+        chunk_hashes[i] = generate_and_hash(i);
+    }
+    uint64_t forward = combine_hashes();
+    
+    for (int i = GRID_CHUNKS - 1; i >= 0; i--) {
+        chunk_hashes[i] = generate_and_hash(i);
+    }
+    uint64_t reverse = combine_hashes();
+    
+    pthread_t threads[THREADS];
+    for (int t = 0; t < THREADS; t++) {
+        pthread_create(&threads[t], NULL, generate_thread, (void*)(intptr_t)t);
+    }
+    for (int t = 0; t < THREADS; t++) {
+        pthread_join(threads[t], NULL);
+    }
+    uint64_t threaded = combine_hashes();
+    
+    CHECK_EQ_U64(forward, reverse);
+    CHECK_EQ_U64(forward, threaded);
+    CHECK_EQ_U64(forward, GOLDEN_HASH);
+    
+    terrain_destroy(terrain);
+    return TEST_RESULT("terrain");
+}
\ No newline at end of file
@@ -0,0 +1,186 @@
+#include "test.h"
+#include "visibility.h"
+#include "camera.h"
+#include "config.h"
+#include <string.h>
+
+// Section graphs must join exactly the faces their see-through regions
+// touch, and the traversal must stop at sections that can't be seen
+// through while still marking the sections it stopped at
+#define GRID 5
+#define CENTER (GRID / 2)
+
+static uint8_t blocks[CHUNK_SECTION_VOLUME];
+static Chunk* grid[GRID][GRID];
+
+static void fill_section(BlockType type) {
+    memset(blocks, type, sizeof(blocks));
+}
+
+static void set_block(int x, int y, int z, BlockType type) {
+    blocks[SECTION_INDEX(x, y, z)] = (uint8_t)type;
+}
+
+static int count_pairs(uint16_t graph) {
+    return __builtin_popcount(graph);
+}
+
+static void check_section_graphs(void) {
+    fill_section(BLOCK_AIR);
+    CHECK(visibility_section_graph(blocks) == VISIBILITY_ALL);
+    fill_section(BLOCK_STONE);
+    CHECK(visibility_section_graph(blocks) == VISIBILITY_NONE);
+    CHECK(visibility_uniform_graph(BLOCK_AIR) == VISIBILITY_ALL);
+    CHECK(visibility_uniform_graph(BLOCK_STONE) == VISIBILITY_NONE);
+    
+    // A tunnel from west to east joins only those two faces
+    for (int x = 0; x < CHUNK_SIZE; x++) set_block(x, 5, 7, BLOCK_AIR);
+    uint16_t graph = visibility_section_graph(blocks);
+    CHECK(count_pairs(graph) == 1);
+    CHECK(visibility_connected(graph, 2, 3));
+    CHECK(visibility_connected(graph, 3, 2));
+    CHECK(!visibility_connected(graph, 0, 2));
+    
+    // A glass shaft from the top meeting it joins three faces, water
+    // counts as see-through too
+    for (int y = 5; y < CHUNK_SECTION_HEIGHT; y++) {
+        set_block(9, y, 7, y % 2 ? BLOCK_GLASS : BLOCK_WATER);
+    }
+    graph = visibility_section_graph(blocks);
+    CHECK(count_pairs(graph) == 3);
+    CHECK(visibility_connected(graph, 0, 2));
+    CHECK(visibility_connected(graph, 0, 3));
+    CHECK(!visibility_connected(graph, 1, 4));
+    
+    // A separate pocket from south to north doesn't join the others
+    for (int z = 0; z < CHUNK_SIZE; z++) set_block(1, 12, z, BLOCK_AIR);
+    graph = visibility_section_graph(blocks);
+    CHECK(count_pairs(graph) == 4);
+    CHECK(visibility_connected(graph, 4, 5));
+    CHECK(!visibility_connected(graph, 2, 4));
+    
+    // A sealed cavity touches no face
+    fill_section(BLOCK_STONE);
+    set_block(8, 8, 8, BLOCK_AIR);
+    CHECK(visibility_section_graph(blocks) == VISIBILITY_NONE);
+}
+
+// A GRID x GRID patch of air chunks, linked like the world links them
+static void reset_grid(void) {
+    for (int x = 0; x < GRID; x++) {
+        for (int z = 0; z < GRID; z++) {
+            chunk_reset(grid[x][z], x - CENTER, z - CENTER);
+            grid[x][z]->is_generated = true;
+        }
+    }
+    for (int x = 0; x < GRID; x++) {
+        for (int z = 0; z < GRID; z++) {
+            grid[x][z]->west = x > 0 ? grid[x - 1][z] : NULL;
+            grid[x][z]->east = x < GRID - 1 ? grid[x + 1][z] : NULL;
+            grid[x][z]->north = z > 0 ? grid[x][z - 1] : NULL;
+            grid[x][z]->south = z < GRID - 1 ? grid[x][z + 1] : NULL;
+        }
+    }
+}
+
+static void fill_layer(int section_y, BlockType type) {
+    fill_section(type);
+    for (int x = 0; x < GRID; x++) {
+        for (int z = 0; z < GRID; z++) {
+            chunk_write_section(grid[x][z], section_y, blocks);
+        }
+    }
+}
+
+static int count_marked(const VisibilityTraversal* traversal, int section_min, int section_max) {
+    int count = 0;
+    for (int x = 0; x < GRID; x++) {
+        for (int z = 0; z < GRID; z++) {
+            Chunk* chunk = grid[x][z];
+            if (chunk->visibility_frame != traversal->frame) continue;
+            for (int sy = section_min; sy <= section_max; sy++) {
+                count += (chunk->visible_sections >> sy) & 1;
+            }
+        }
+    }
+    return count;
+}
+
+static void check_traversal(void) {
+    static VisibilityNode queue[GRID * GRID * CHUNK_SECTION_COUNT];
+    VisibilityTraversal traversal = { queue, GRID * GRID * CHUNK_SECTION_COUNT, 0, 0 };
+    Chunk* center = grid[CENTER][CENTER];
+    
+    // Open air, everything is reachable
+    reset_grid();
+    CHECK(visibility_traverse(&traversal, center, 8, NULL));
+    CHECK(traversal.sections_reached == GRID * GRID * CHUNK_SECTION_COUNT);
+    CHECK(count_marked(&traversal, 0, CHUNK_SECTION_COUNT - 1) == traversal.sections_reached);
+    
+    // A stone floor: it's reached, nothing under it is
+    fill_layer(4, BLOCK_STONE);
+    CHECK(visibility_traverse(&traversal, center, 8, NULL));
+    CHECK(count_marked(&traversal, 0, 3) == 0);
+    CHECK(count_marked(&traversal, 4, 4) == GRID * GRID);
+    CHECK(traversal.sections_reached == GRID * GRID * (CHUNK_SECTION_COUNT - 4));
+    
+    // Buried in stone, the camera sees its own section's six neighbors
+    fill_layer(7, BLOCK_STONE);
+    fill_layer(8, BLOCK_STONE);
+    fill_layer(9, BLOCK_STONE);
+    CHECK(visibility_traverse(&traversal, center, 8, NULL));
+    CHECK(traversal.sections_reached == 7);
+    
+    // A frame-old mark doesn't count
+    uint32_t frame = traversal.frame;
+    CHECK(visibility_traverse(&traversal, center, 8, NULL));
+    CHECK(traversal.frame == frame + 1);
+    CHECK(count_marked(&traversal, 0, CHUNK_SECTION_COUNT - 1) == 7);
+    
+    // Too small a queue cuts the walk short and says so
+    reset_grid();
+    traversal.capacity = 10;
+    CHECK(!visibility_traverse(&traversal, center, 8, NULL));
+    traversal.capacity = GRID * GRID * CHUNK_SECTION_COUNT;
+    CHECK(!visibility_traverse(&traversal, center, CHUNK_SECTION_COUNT, NULL));
+    
+    // Looking east from the middle of the center chunk, the column of
+    // chunks behind the camera is outside the frustum
+    float eye[3] = { 8.0f, 8.5f * CHUNK_SECTION_HEIGHT, 8.0f };
+    float target[3] = { 100.0f, eye[1], 8.0f };
+    float up[3] = { 0.0f, 1.0f, 0.0f };
+    float projection[16], view[16], clip[16];
+    mat4_perspective(projection, FOV, 16.0f / 9.0f, NEAR_PLANE, FAR_PLANE);
+    mat4_look_at(view, eye, target, up);
+    mat4_multiply(clip, view, projection);
+    Frustum frustum;
+    frustum_from_matrix(&frustum, clip);
+    
+    CHECK(visibility_traverse(&traversal, center, 8, &frustum));
+    for (int z = 0; z < GRID; z++) {
+        CHECK(grid[0][z]->visibility_frame != traversal.frame ||
+              grid[0][z]->visible_sections == 0);
+    }
+    CHECK(grid[GRID - 1][CENTER]->visibility_frame == traversal.frame &&
+          ((grid[GRID - 1][CENTER]->visible_sections >> 8) & 1));
+    CHECK(traversal.sections_reached < GRID * GRID * CHUNK_SECTION_COUNT / 2);
+}
+
+int main(void) {
+    blocks_init();
+    check_section_graphs();
+    
+    for (int x = 0; x < GRID; x++) {
+        for (int z = 0; z < GRID; z++) {
+            grid[x][z] = chunk_create(x - CENTER, z - CENTER);
+        }
+    }
+    check_traversal();
+    for (int x = 0; x < GRID; x++) {
+        for (int z = 0; z < GRID; z++) {
+            chunk_destroy(grid[x][z]);
+        }
+    }
+    
+    return TEST_RESULT("visibility");
+}
\ No newline at end of file